@@ -45,7 +45,7 @@ if [[ "$UBUNTU_VERSION" == "22.04" ]]; then
     QT_MAJOR="5"
     PACKAGE_NAME="wkhtmltopdf-qt5-webengine"
     # Ubuntu 22.04 specific dependencies (note: qt5-default is deprecated but still works)
-    DEPS="qtbase5-dev qt5-qmake qtwebengine5-dev libqt5webenginewidgets5 libqt5webenginecore5 libqt5svg5-dev libqt5xmlpatterns5-dev libqt5network5 libqt5printsupport5 libqt5positioning5 libqt5core5a libqt5gui5 build-essential"
+    DEPS="qtbase5-dev qtbase5-private-dev qt5-qmake qtwebengine5-dev libqt5webenginewidgets5 libqt5webenginecore5 libqt5svg5-dev libqt5xmlpatterns5-dev libqt5network5 libqt5printsupport5 libqt5positioning5 libqt5core5a libqt5gui5 build-essential"
     QMAKE_CMD="qmake"
 
     # Additional system dependencies for Ubuntu 22.04 (fixes libwkhtmltox issues)
@@ -222,8 +222,10 @@ EOF
 
 # Add dependencies based on Qt version
 if [[ "$QT_VERSION" == "qt5" ]]; then
+    # libwkhtmltox uses private Qt 5 API, it only works with the Qt it was built against
+    QT_ABI=$(dpkg-query -W -f='${Provides}' libqt5core5a 2>/dev/null | grep -o 'qtbase-abi-[0-9-]*' | head -n1)
     cat >> "$DEB_DIR/DEBIAN/control" << EOF
-Depends: libqt5core5a, libqt5gui5, libqt5network5, libqt5svg5, libqt5xmlpatterns5, libqt5webenginecore5, libqt5webenginewidgets5, libqt5printsupport5, libqt5positioning5, libssl3 | libssl1.1, libfontconfig1, libfreetype6, libx11-6, libxrender1, libxext6, libc6, libnss3, libxcomposite1, libxcursor1, libxdamage1, libxi6, libxtst6
+Depends: ${QT_ABI:+$QT_ABI, }libqt5core5a, libqt5gui5, libqt5network5, libqt5svg5, libqt5xmlpatterns5, libqt5webenginecore5, libqt5webenginewidgets5, libqt5printsupport5, libqt5positioning5, libssl3 | libssl1.1, libfontconfig1, libfreetype6, libx11-6, libxrender1, libxext6, libc6, libnss3, libxcomposite1, libxcursor1, libxdamage1, libxi6, libxtst6
 Recommends: qtwebengine5-dev
 EOF
 else
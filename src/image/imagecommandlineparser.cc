@@ -54,6 +54,7 @@ void ImageCommandLineParser::usage(FILE * fd, bool extended) const {
 	outputSwitches(o, extended, false);
 	if (extended) {
 		outputProxyDoc(o);
+		outputRequestRulesDoc(o);
 	}
  	outputContact(o);
 	delete o;
@@ -73,6 +74,7 @@ void ImageCommandLineParser::readme(FILE * fd, bool html) const {
 	outputSynopsis(o);
 	outputSwitches(o, true, true);
  	outputProxyDoc(o);
+ 	outputRequestRulesDoc(o);
 	outputStaticProblems(o);
 	outputCompilation(o);
 	outputInstallation(o);
@@ -23,6 +23,7 @@
 #include <QApplication>
 #include <imageconverter.hh>
 #include <imagesettings.hh>
+#include <renderengine.hh>
 #include <utilities.hh>
 
 #if defined(Q_OS_UNIX)
@@ -43,6 +44,7 @@ int main(int argc, char** argv) {
 	//Parse the arguments
 	parser.parseArguments(argc, (const char**)argv);
 
+	wkhtmltopdf::RenderEngineFactory::initialize();
 
 	bool use_graphics=true;
 #if defined(Q_OS_UNIX) || defined(Q_OS_MAC)
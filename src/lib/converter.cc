@@ -65,7 +65,7 @@ void ConverterPrivate::fail() {
 	conversionDone = true;
 	clearResources();
 	emit outer().finished(false);
-	qApp->exit(0); // quit qt's event handling
+	if (quitOnFinished) qApp->exit(0); // quit qt's event handling
 }
 
 /*!
@@ -95,6 +95,9 @@ void ConverterPrivate::forwardDebug(QString debug) {
 
 void ConverterPrivate::cancel() {
 	error=true;
+	if (conversionDone) return;
+	emit outer().error("The conversion was cancelled");
+	fail();
 }
 
 bool ConverterPrivate::convert() {
@@ -144,11 +147,22 @@ int Converter::httpErrorCode() {
 	return priv().errorCode;
 }
 
+/*!
+  \brief Choose if the application event loop is left when the conversion is done
+
+  By default an asynchronous conversion quits the event loop once it is
+  finished. Disable this when several conversions share one event loop.
+*/
+void Converter::setQuitOnFinished(bool quit) {
+	priv().quitOnFinished = quit;
+}
+
 /*!
   \brief Start a asynchronous conversion of html pages to a pdf document.
   Once conversion is done an finished signal will be emitted
 */
 void Converter::beginConversion() {
+	priv().conversionDone = false;
 	priv().beginConvert();
 }
 
@@ -161,6 +175,8 @@ bool Converter::convert() {
 
 /*!
   \brief Cancel a running conversion
+
+  The conversion fails right away and finished is emitted.
 */
 void Converter::cancel() {
 	priv().cancel();
@@ -39,6 +39,7 @@ public:
     QString phaseDescription(int phase=-1);
     QString progressString();
     int httpErrorCode();
+	void setQuitOnFinished(bool quit);
 signals:
     void debug(const QString & message);
     void info(const QString & message);
@@ -35,6 +35,7 @@ namespace wkhtmltopdf {
 class DLL_LOCAL ConverterPrivate: public QObject {
 	Q_OBJECT
 public:
+	ConverterPrivate(): conversionDone(true), quitOnFinished(true) {}
 	void copyFile(QFile & src, QFile & dst);
 
 	QList<QString> phaseDescriptions;
@@ -48,6 +49,8 @@ protected:
 	int errorCode;
 
 	bool conversionDone;
+	//Should the application event loop be left once the conversion is done
+	bool quitOnFinished;
 
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	void updateWebSettings(QWebSettings * ws, const settings::Web & s) const;
@@ -0,0 +1,194 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "eventdispatcher.hh"
+#ifdef WKHTMLTOPDF_EVENT_FD
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QtCore/private/qeventdispatcher_unix_p.h>
+#include <qpa/qwindowsysteminterface.h>
+#include <cerrno>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+/*!
+  \file eventdispatcher.hh
+  \brief Defines the PollableEventDispatcher class
+*/
+
+/*!
+  Read what a descriptor holds, so it is no longer readable
+*/
+static void drain(int fd) {
+	uint64_t value;
+	while (read(fd, &value, sizeof(value)) > 0 || errno == EINTR) {}
+}
+
+PollableEventDispatcher::PollableEventDispatcher(QObject * parent):
+	QAbstractEventDispatcher(parent), dispatcher(new QEventDispatcherUNIX(this)) {
+	connect(dispatcher, SIGNAL(aboutToBlock()), this, SIGNAL(aboutToBlock()));
+	connect(dispatcher, SIGNAL(awake()), this, SIGNAL(awake()));
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	int fds[] = {wakeFd, timerFd};
+	for (int i=0; i < 2; ++i) {
+		struct epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = fds[i];
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, fds[i], &event);
+	}
+}
+
+PollableEventDispatcher::~PollableEventDispatcher() {
+	close(timerFd);
+	close(wakeFd);
+	close(epollFd);
+}
+
+/*!
+  Process events like the platform dispatcher of a gui application does
+*/
+bool PollableEventDispatcher::processEvents(QEventLoop::ProcessEventsFlags flags) {
+	//Wake ups arriving from here on are for events this call may not see
+	drain(wakeFd);
+	drain(timerFd);
+	bool sent = dispatcher->processEvents(flags);
+	sent = QWindowSystemInterface::sendWindowSystemEvents(flags) || sent;
+	armTimer();
+	return sent;
+}
+
+bool PollableEventDispatcher::hasPendingEvents() {
+	return dispatcher->hasPendingEvents() || QWindowSystemInterface::windowSystemEventsQueued();
+}
+
+void PollableEventDispatcher::registerSocketNotifier(QSocketNotifier * notifier) {
+	dispatcher->registerSocketNotifier(notifier);
+	notifiers.insert(notifier->socket(), notifier);
+	watch(notifier->socket());
+}
+
+void PollableEventDispatcher::unregisterSocketNotifier(QSocketNotifier * notifier) {
+	dispatcher->unregisterSocketNotifier(notifier);
+	notifiers.remove(notifier->socket(), notifier);
+	watch(notifier->socket());
+}
+
+void PollableEventDispatcher::registerTimer(int timerId, int interval, Qt::TimerType timerType, QObject * object) {
+	dispatcher->registerTimer(timerId, interval, timerType, object);
+	timers.insert(timerId, object);
+	armTimer();
+}
+
+bool PollableEventDispatcher::unregisterTimer(int timerId) {
+	timers.remove(timerId);
+	return dispatcher->unregisterTimer(timerId);
+}
+
+bool PollableEventDispatcher::unregisterTimers(QObject * object) {
+	for (QHash<int, QObject *>::iterator i=timers.begin(); i != timers.end();) {
+		if (i.value() == object) i = timers.erase(i);
+		else ++i;
+	}
+	return dispatcher->unregisterTimers(object);
+}
+
+QList<QAbstractEventDispatcher::TimerInfo> PollableEventDispatcher::registeredTimers(QObject * object) const {
+	return dispatcher->registeredTimers(object);
+}
+
+int PollableEventDispatcher::remainingTime(int timerId) {
+	return dispatcher->remainingTime(timerId);
+}
+
+/*!
+  Wake the dispatcher, this may be called from any thread
+*/
+void PollableEventDispatcher::wakeUp() {
+	dispatcher->wakeUp();
+	uint64_t one = 1;
+	if (write(wakeFd, &one, sizeof(one)) != sizeof(one)) {}
+}
+
+void PollableEventDispatcher::interrupt() {
+	dispatcher->interrupt();
+	wakeUp();
+}
+
+void PollableEventDispatcher::flush() {
+	if (qApp) qApp->sendPostedEvents();
+}
+
+void PollableEventDispatcher::startingUp() {
+	dispatcher->startingUp();
+}
+
+void PollableEventDispatcher::closingDown() {
+	dispatcher->closingDown();
+}
+
+/*!
+  Watch a descriptor for what its enabled notifiers wait for
+*/
+void PollableEventDispatcher::watch(int fd) {
+	struct epoll_event event = {};
+	event.data.fd = fd;
+	foreach (QSocketNotifier * notifier, notifiers.values(fd)) {
+		switch (notifier->type()) {
+		case QSocketNotifier::Read: event.events |= EPOLLIN; break;
+		case QSocketNotifier::Write: event.events |= EPOLLOUT; break;
+		case QSocketNotifier::Exception: event.events |= EPOLLPRI; break;
+		}
+	}
+	if (event.events == 0)
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &event);
+	else if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) != 0 && errno == ENOENT)
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+/*!
+  Make the timer descriptor readable once the next timer is due
+*/
+void PollableEventDispatcher::armTimer() {
+	int next = -1;
+	for (QHash<int, QObject *>::const_iterator i=timers.constBegin(); i != timers.constEnd(); ++i) {
+		int remaining = dispatcher->remainingTime(i.key());
+		if (remaining >= 0 && (next < 0 || remaining < next)) next = remaining;
+	}
+	struct itimerspec spec = {};
+	if (next == 0)
+		spec.it_value.tv_nsec = 1;
+	else if (next > 0) {
+		spec.it_value.tv_sec = next / 1000;
+		spec.it_value.tv_nsec = (next % 1000) * 1000000L;
+	}
+	//A zero value disarms the timer when none is left
+	timerfd_settime(timerFd, 0, &spec, 0);
+}
+
+}
+#include "dllend.inc"
+#endif
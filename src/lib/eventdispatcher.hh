@@ -0,0 +1,80 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __EVENTDISPATCHER_HH__
+#define __EVENTDISPATCHER_HH__
+
+#include <QtGlobal>
+
+#if defined(Q_OS_LINUX) && QT_VERSION >= 0x050000 && QT_VERSION < 0x060000
+#define WKHTMLTOPDF_EVENT_FD
+#include <QAbstractEventDispatcher>
+#include <QHash>
+#include <QMultiHash>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+
+/*!
+  \brief Event dispatcher whose pending work can be waited for with poll
+
+  Wraps the unix event dispatcher of Qt and mirrors its sources into an
+  epoll descriptor: the enabled socket notifiers, a timerfd armed for the
+  next timer and an eventfd written on every wake up. The descriptor is
+  readable whenever processing events would do some work, so an application
+  can wait for it together with its own descriptors instead of polling.
+*/
+class DLL_LOCAL PollableEventDispatcher: public QAbstractEventDispatcher {
+	Q_OBJECT
+public:
+	PollableEventDispatcher(QObject * parent=0);
+	~PollableEventDispatcher();
+	int fd() const {return epollFd;}
+
+	bool processEvents(QEventLoop::ProcessEventsFlags flags);
+	bool hasPendingEvents();
+	void registerSocketNotifier(QSocketNotifier * notifier);
+	void unregisterSocketNotifier(QSocketNotifier * notifier);
+	void registerTimer(int timerId, int interval, Qt::TimerType timerType, QObject * object);
+	bool unregisterTimer(int timerId);
+	bool unregisterTimers(QObject * object);
+	QList<TimerInfo> registeredTimers(QObject * object) const;
+	int remainingTime(int timerId);
+	void wakeUp();
+	void interrupt();
+	void flush();
+	void startingUp();
+	void closingDown();
+private:
+	void watch(int fd);
+	void armTimer();
+
+	QAbstractEventDispatcher * dispatcher;
+	int epollFd;
+	int wakeFd;
+	int timerFd;
+	QMultiHash<int, QSocketNotifier *> notifiers;
+	QHash<int, QObject *> timers;
+};
+
+}
+#include "dllend.inc"
+#endif
+#endif //__EVENTDISPATCHER_HH__
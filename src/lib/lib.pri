@@ -20,9 +20,11 @@ DEFINES += BUILDING_DLL
 #Shared
 PUBLIC_HEADERS += ../lib/converter.hh ../lib/multipageloader.hh ../lib/dllbegin.inc
 PUBLIC_HEADERS += ../lib/dllend.inc ../lib/loadsettings.hh ../lib/websettings.hh
-PUBLIC_HEADERS += ../lib/utilities.hh
-HEADERS += ../lib/multipageloader_p.hh  ../lib/converter_p.hh
+PUBLIC_HEADERS += ../lib/utilities.hh ../lib/networktiming.hh
+HEADERS += ../lib/multipageloader_p.hh  ../lib/converter_p.hh ../lib/memorycache.hh \
+	   ../lib/requestrules.hh
 SOURCES += ../lib/loadsettings.cc ../lib/logging.cc ../lib/multipageloader.cc \
+	   ../lib/memorycache.cc ../lib/requestrules.cc ../lib/networktiming.cc \
 	   ../lib/tempfile.cc ../lib/converter.cc ../lib/websettings.cc  \
   	   ../lib/reflect.cc ../lib/utilities.cc
 
@@ -42,8 +44,8 @@ contains(DEFINES, WKHTMLTOPDF_USE_WEBENGINE) {
 
 #Pdf
 PUBLIC_HEADERS += ../lib/pdfconverter.hh ../lib/pdfsettings.hh
-HEADERS += ../lib/pdfconverter_p.hh
-SOURCES += ../lib/pdfsettings.cc ../lib/pdfconverter.cc \
+HEADERS += ../lib/pdfconverter_p.hh ../lib/pdfmerger.hh
+SOURCES += ../lib/pdfsettings.cc ../lib/pdfconverter.cc ../lib/pdfmerger.cc \
            ../lib/outline.cc ../lib/tocstylesheet.cc
 
 PUBLIC_HEADERS += ../lib/imageconverter.hh ../lib/imagesettings.hh
@@ -55,5 +57,14 @@ PUBLIC_HEADERS += ../lib/pdf.h ../lib/image.h
 HEADERS += ../lib/pdf_c_bindings_p.hh ../lib/image_c_bindings_p.hh
 SOURCES += ../lib/pdf_c_bindings.cc ../lib/image_c_bindings.cc
 
+# Event dispatcher behind wkhtmltopdf_event_fd, only built with Qt 5 as it
+# wraps QEventDispatcherUNIX: needs the private headers (qtbase5-private-dev)
+# and ties the library to the exact Qt 5 version it was built against
+linux:equals(QT_MAJOR_VERSION, 5) {
+    QT += core-private gui-private
+    HEADERS += ../lib/eventdispatcher.hh
+    SOURCES += ../lib/eventdispatcher.cc
+}
+
 
 HEADERS += $$PUBLIC_HEADERS
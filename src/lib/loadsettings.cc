@@ -134,11 +134,17 @@ Proxy::Proxy():
 	password() {}
 
 LoadGlobal::LoadGlobal():
-	cookieJar("") {}
+	cookieJar(""),
+	maxParallelPages(0),
+	shareConnections(false),
+	memoryCacheSize(0),
+	shareMemoryCache(false) {}
 
 LoadPage::LoadPage():
 	jsdelay(200),
 	windowStatus(""),
+	networkIdle(0),
+	networkIdleTimeout(30000),
 	zoomFactor(1.0),
 	repeatCustomHeaders(false),
 	blockLocalFileAccess(true),
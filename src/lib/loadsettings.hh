@@ -53,6 +53,18 @@ struct DLL_PUBLIC LoadGlobal {
 	LoadGlobal();
 	//! Path of the cookie jar file
 	QString cookieJar;
+
+	//! Maximal number of objects loaded and printed at the same time, 0 for no limit
+	int maxParallelPages;
+
+	//! Should objects loading through the same proxy and cache share one network access manager
+	bool shareConnections;
+
+	//! Megabytes of responses kept in memory for all loads, 0 to disable the memory cache
+	int memoryCacheSize;
+
+	//! Should the memory cache be shared with the other conversions of the process
+	bool shareMemoryCache;
 };
 
 struct DLL_PUBLIC LoadPage {
@@ -85,6 +97,12 @@ struct DLL_PUBLIC LoadPage {
 	//! What window.status value should we wait for
 	QString windowStatus;
 
+	//! Consider the page ready after this many milliseconds without network activity, 0 to use jsdelay
+	int networkIdle;
+
+	//! The longest time in milliseconds we wait for the network to become idle, 0 for no limit
+	int networkIdleTimeout;
+
 	//! What zoom factor should we apply when printing
 	// TODO MOVE
 	float zoomFactor;
@@ -106,6 +124,9 @@ struct DLL_PUBLIC LoadPage {
 	//! If access to local files is not allowed in general, allow it for these files
 	QList< QString > allowed;
 
+	//! Path of a file with rules blocking or rewriting requests, see RequestRules
+	QString requestRules;
+
 	//! Stop Javascript from running too long
 	bool stopSlowScripts;
 
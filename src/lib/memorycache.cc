@@ -0,0 +1,184 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "memorycache.hh"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QPair>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+/*!
+  \file memorycache.hh
+  \brief Defines the MemoryCache class
+*/
+
+QHash<qint64, QWeakPointer<MemoryCache::Store> > MemoryCache::sharedStores;
+
+/*!
+  \param maximumSize The number of bytes the bodies of the cached responses may take
+*/
+MemoryCache::Store::Store(qint64 maximumSize): size(0), maximumSize(maximumSize) {}
+
+/*!
+  \brief Remove an entry, and its body once no other entry refers to it
+*/
+void MemoryCache::Store::drop(const QUrl & url) {
+	Entry entry = entries.take(url);
+	recent.removeOne(url);
+	Body & body = bodies[entry.hash];
+	if (--body.references > 0) return;
+	size -= body.data.size();
+	bodies.remove(entry.hash);
+}
+
+/*!
+  \brief Remove the least recently used entries until the bodies fit the budget
+*/
+void MemoryCache::Store::evict() {
+	while (size > maximumSize && !recent.isEmpty()) {
+		QUrl url = recent.last();
+		drop(url);
+	}
+}
+
+/*!
+  \brief Get the store shared by the conversions asking for one with the given budget
+
+  The store lives as long as a conversion uses it.
+*/
+QSharedPointer<MemoryCache::Store> MemoryCache::sharedStore(qint64 maximumSize) {
+	QSharedPointer<Store> store = sharedStores.value(maximumSize).toStrongRef();
+	if (!store) {
+		store = QSharedPointer<Store>(new Store(maximumSize));
+		sharedStores[maximumSize] = store;
+	}
+	return store;
+}
+
+/*!
+  \brief Create a cache for one network access manager
+  \param store Where the responses are kept
+*/
+MemoryCache::MemoryCache(QSharedPointer<Store> store, QObject * parent):
+	QAbstractNetworkCache(parent), store(store) {}
+
+MemoryCache::~MemoryCache() {
+	foreach (QIODevice * device, inserting.keys())
+		delete device;
+}
+
+QNetworkCacheMetaData MemoryCache::metaData(const QUrl & url) {
+	if (!store->entries.contains(url)) return QNetworkCacheMetaData();
+	return store->entries[url].metaData;
+}
+
+void MemoryCache::updateMetaData(const QNetworkCacheMetaData & metaData) {
+	if (store->entries.contains(metaData.url()))
+		store->entries[metaData.url()].metaData = metaData;
+}
+
+QIODevice * MemoryCache::data(const QUrl & url) {
+	if (!store->entries.contains(url)) return 0;
+	store->recent.removeOne(url);
+	store->recent.prepend(url);
+	QBuffer * buffer = new QBuffer();
+	buffer->setData(store->bodies[store->entries[url].hash].data);
+	buffer->open(QIODevice::ReadOnly);
+	return buffer;
+}
+
+bool MemoryCache::remove(const QUrl & url) {
+	//The download of a prepared response failed
+	foreach (QIODevice * device, inserting.keys()) {
+		if (inserting[device].url() != url) continue;
+		inserting.remove(device);
+		delete device;
+	}
+	if (!store->entries.contains(url)) return false;
+	store->drop(url);
+	return true;
+}
+
+qint64 MemoryCache::cacheSize() const {
+	return store->size;
+}
+
+/*!
+  \brief Get a buffer to download a response into, or 0 if it should not be cached
+
+  The cache is only keyed by url, so responses that vary on anything but the
+  encoding, which the network access manager handles itself, are not stored.
+  Neither are private responses, the requests carrying credentials are kept
+  out by MyNetworkAccessManager, which sees their headers.
+*/
+QIODevice * MemoryCache::prepare(const QNetworkCacheMetaData & metaData) {
+	if (store->maximumSize <= 0 || !metaData.isValid() || !metaData.saveToDisk()) return 0;
+	typedef QPair<QByteArray, QByteArray> HT;
+	foreach (const HT & header, metaData.rawHeaders()) {
+		QByteArray name = header.first.toLower();
+		QByteArray value = header.second.toLower();
+		if (name == "cache-control" && (value.contains("no-store") || value.contains("private"))) return 0;
+		if (name != "vary") continue;
+		foreach (const QByteArray & field, value.split(','))
+			if (field.trimmed() != "accept-encoding") return 0;
+	}
+	QBuffer * buffer = new QBuffer();
+	buffer->open(QIODevice::ReadWrite);
+	inserting[buffer] = metaData;
+	return buffer;
+}
+
+void MemoryCache::insert(QIODevice * device) {
+	if (!inserting.contains(device)) return;
+	QNetworkCacheMetaData metaData = inserting.take(device);
+	QByteArray data = static_cast<QBuffer *>(device)->data();
+	delete device;
+	if (data.size() > store->maximumSize) return;
+
+	QUrl url = metaData.url();
+	if (store->entries.contains(url)) store->drop(url);
+	QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+	if (store->bodies.contains(hash))
+		++store->bodies[hash].references;
+	else {
+		Store::Body body;
+		body.data = data;
+		body.references = 1;
+		store->bodies[hash] = body;
+		store->size += data.size();
+	}
+	Store::Entry entry;
+	entry.metaData = metaData;
+	entry.hash = hash;
+	store->entries[url] = entry;
+	store->recent.prepend(url);
+	store->evict();
+}
+
+void MemoryCache::clear() {
+	store->entries.clear();
+	store->bodies.clear();
+	store->recent.clear();
+	store->size = 0;
+}
+
+}
+#include "dllend.inc"
@@ -0,0 +1,98 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __MEMORYCACHE_HH__
+#define __MEMORYCACHE_HH__
+
+#include <QAbstractNetworkCache>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QNetworkCacheMetaData>
+#include <QSharedPointer>
+#include <QUrl>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+
+/*!
+  \brief Network cache keeping responses in memory
+
+  A network access manager owns its cache, so every manager gets an instance
+  of its own, but the entries are kept in a Store: all loaders of a
+  conversion share one, and conversions of a server or batch run only share
+  one when asked to. Bodies are stored once by content hash, the least
+  recently used entries are evicted when the bodies exceed the budget of the
+  store. Responses to requests carrying credentials and private responses
+  are never stored.
+
+  Only the WebKit backend loads through the network access managers.
+  WebEngine pages load through Chromium, which keeps an HTTP cache of its own
+  per browser context.
+*/
+class DLL_LOCAL MemoryCache: public QAbstractNetworkCache {
+	Q_OBJECT
+public:
+	struct Store {
+		struct Entry {
+			QNetworkCacheMetaData metaData;
+			QByteArray hash;
+		};
+		struct Body {
+			QByteArray data;
+			int references;
+		};
+
+		Store(qint64 maximumSize);
+		void drop(const QUrl & url);
+		void evict();
+
+		QHash<QUrl, Entry> entries;
+		QHash<QByteArray, Body> bodies;
+		//Cached urls, the most recently used first
+		QList<QUrl> recent;
+		qint64 size;
+		qint64 maximumSize;
+	};
+
+	static QSharedPointer<Store> sharedStore(qint64 maximumSize);
+	MemoryCache(QSharedPointer<Store> store, QObject * parent=0);
+	~MemoryCache();
+	QNetworkCacheMetaData metaData(const QUrl & url);
+	void updateMetaData(const QNetworkCacheMetaData & metaData);
+	QIODevice * data(const QUrl & url);
+	bool remove(const QUrl & url);
+	qint64 cacheSize() const;
+	QIODevice * prepare(const QNetworkCacheMetaData & metaData);
+	void insert(QIODevice * device);
+public slots:
+	void clear();
+private:
+	QSharedPointer<Store> store;
+	//Responses being downloaded into a buffer returned by prepare
+	QHash<QIODevice *, QNetworkCacheMetaData> inserting;
+
+	//Stores shared between conversions, by their budget
+	static QHash<qint64, QWeakPointer<Store> > sharedStores;
+};
+
+}
+#include "dllend.inc"
+#endif //__MEMORYCACHE_HH__
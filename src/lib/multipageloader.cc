@@ -19,14 +19,19 @@
 // along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "multipageloader_p.hh"
+#include "memorycache.hh"
 #include <QFile>
 #include <QFileInfo>
+#include <QHttpMultiPart>
 #include <QNetworkCookie>
 #include <QNetworkDiskCache>
 #include <QTimer>
-#include <QUuid>
 #include <QList>
+#include <QBuffer>
 #include <QByteArray>
+#include <QDir>
+#include <QDateTime>
+#include <QStringList>
 #if (QT_VERSION >= 0x050000 && !defined QT_NO_SSL) || !defined QT_NO_OPENSSL
 #include <QSslCertificate>
 #include <QSslKey>
@@ -35,6 +40,10 @@
 #if QT_VERSION >= 0x050000
 #include <QUrlQuery>
 #endif
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <unistd.h>
+#endif
 
 namespace wkhtmltopdf {
 /*!
@@ -49,62 +58,273 @@ namespace wkhtmltopdf {
 
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 LoaderObject::LoaderObject(QWebPage & p): page(p), skip(false) {};
+#else
+LoaderObject::LoaderObject(RenderPage & p): page(p), skip(false) {};
 #endif
 
-MyNetworkAccessManager::MyNetworkAccessManager(const settings::LoadPage & s):
-	disposed(false),
-	settings(s) {
+MyNetworkAccessManager::MyNetworkAccessManager(const settings::LoadPage & s, QObject * parent):
+	QNetworkAccessManager(parent) {
 
 	if ( !s.cacheDir.isEmpty() ){
 		QNetworkDiskCache *cache = new QNetworkDiskCache(this);
 		cache->setCacheDirectory(s.cacheDir);
 		QNetworkAccessManager::setCache(cache);
 	}
+
+	//If we must use a proxy, create a host of objects
+	if (!s.proxy.host.isEmpty()) {
+		QNetworkProxy proxy;
+		proxy.setHostName(s.proxy.host);
+		proxy.setPort(s.proxy.port);
+		proxy.setType(s.proxy.type);
+
+		if (s.proxy.type == QNetworkProxy::HttpProxy) {
+			QNetworkProxy::Capabilities capabilities = QNetworkProxy::CachingCapability | QNetworkProxy::TunnelingCapability;
+			if (s.proxyHostNameLookup)
+				capabilities |= QNetworkProxy::HostNameLookupCapability;
+			proxy.setCapabilities(capabilities);
+		}
+		if (!s.proxy.user.isEmpty())
+			proxy.setUser(s.proxy.user);
+		if (!s.proxy.password.isEmpty())
+			proxy.setPassword(s.proxy.password);
+		if (!s.bypassProxyForHosts.isEmpty())
+			setProxyFactory(new MyNetworkProxyFactory(proxy, s.bypassProxyForHosts));
+		else
+			setProxy(proxy);
+	}
 }
 
-void MyNetworkAccessManager::dispose() {
-	disposed = true;
+/*!
+ * Get the part of the settings a manager is configured with in the constructor,
+ * resources can only share a manager when these agree
+ */
+QString MyNetworkAccessManager::shareKey(const settings::LoadPage & s) {
+	QStringList parts;
+	parts << s.cacheDir << s.proxy.host << QString::number(s.proxy.port)
+		  << QString::number(s.proxy.type) << s.proxy.user << s.proxy.password
+		  << QString::number(s.proxyHostNameLookup) << QStringList(s.bypassProxyForHosts).join(",");
+	return parts.join(QChar('\n'));
 }
 
-void MyNetworkAccessManager::allow(QString path) {
-	QString x = QFileInfo(path).canonicalFilePath();
-	if (x.isEmpty()) return;
-	allowed.insert(x);
+/*!
+ * Start serving a resource
+ * \param resource The resource
+ * \param origin The object requests of the resource originate from, or one of its ancestors
+ */
+void MyNetworkAccessManager::attach(ResourceObject * resource, QObject * origin) {
+	origins[origin] = resource;
+}
+
+/*!
+ * Forget everything about a resource that is going away
+ */
+void MyNetworkAccessManager::detach(ResourceObject * resource) {
+	QList<QObject *> keys = origins.keys(resource);
+	foreach (QObject * origin, keys)
+		origins.remove(origin);
+	disposed.remove(resource);
+	QList<QNetworkReply *> running = replies.keys(resource);
+	foreach (QNetworkReply * reply, running)
+		replies[reply] = 0;
+}
+
+void MyNetworkAccessManager::dispose(ResourceObject * resource) {
+	disposed.insert(resource);
+}
+
+/*!
+ * Abort every request of a resource that is still running
+ */
+void MyNetworkAccessManager::abortAll(ResourceObject * resource) {
+	//Aborting emits finished, which would report the reply as done
+	QList<QNetworkReply *> running = replies.keys(resource);
+	foreach (QNetworkReply * reply, running)
+		replies.remove(reply);
+	foreach (QNetworkReply * reply, running)
+		reply->abort();
+}
+
+/*!
+ * Find the resource requests from an object are made for
+ *
+ * Frames are children of the page they are in, so the parents are searched as well.
+ * Requests without a known origin can only be attributed when a single resource is served.
+ */
+ResourceObject * MyNetworkAccessManager::resourceFor(QObject * origin) const {
+	for (QObject * o = origin; o; o = o->parent())
+		if (origins.contains(o)) return origins.value(o);
+	if (origins.size() == 1) return origins.begin().value();
+	return 0;
+}
+
+ResourceObject * MyNetworkAccessManager::resourceFor(QNetworkReply * reply) const {
+	if (replies.contains(reply)) return replies.value(reply);
+	return resourceFor(reply->request().originatingObject());
+}
+
+int MyNetworkAccessManager::pending(ResourceObject * resource) const {
+	return replies.keys(resource).size();
+}
+
+/*!
+ * Report the timing of a finished request to the resource it was made for
+ */
+void MyNetworkAccessManager::replyFinished() {
+	QNetworkReply * reply = static_cast<QNetworkReply *>(sender());
+	ResourceObject * resource = replies.value(reply);
+	if (resource && timings.contains(reply)) {
+		Timing & t = timings[reply];
+		qreal elapsed = t.timer.nsecsElapsed() / 1000000.0;
+		if (t.timing.wait < 0) t.timing.wait = elapsed;
+		t.timing.receive = elapsed - t.timing.wait;
+		t.timing.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+		if (t.timing.bytes < 0) t.timing.bytes = 0;
+		resource->requestDone(t.timing);
+	}
+	replyDone();
+}
+
+/*!
+ * The headers of a response have arrived
+ */
+void MyNetworkAccessManager::replyResponded() {
+	QNetworkReply * reply = static_cast<QNetworkReply *>(sender());
+	if (!timings.contains(reply)) return;
+	Timing & t = timings[reply];
+	if (t.timing.wait < 0) t.timing.wait = t.timer.nsecsElapsed() / 1000000.0;
+}
+
+void MyNetworkAccessManager::replyProgress(qint64 received, qint64) {
+	QNetworkReply * reply = static_cast<QNetworkReply *>(sender());
+	if (timings.contains(reply)) timings[reply].timing.bytes = received;
+}
+
+void MyNetworkAccessManager::replyDone() {
+	QNetworkReply * reply = static_cast<QNetworkReply *>(sender());
+	timings.remove(reply);
+	if (!replies.contains(reply)) return;
+	ResourceObject * resource = replies.take(reply);
+	if (resource) resource->networkActivity(pending(resource));
+}
+
+#if (QT_VERSION >= 0x050000 && !defined QT_NO_SSL) || !defined QT_NO_OPENSSL
+QHash<QString, QSslConfiguration> MyNetworkAccessManager::sslConfigurations;
+
+/*!
+ * Get the ssl configuration presenting the client certificate of the settings
+ *
+ * The key and the certificate chain are only parsed the first time they are
+ * used, or when one of the files has changed since.
+ * \return the configuration, or a null one if the key or the certificates could not be read
+ */
+QSslConfiguration MyNetworkAccessManager::clientSslConfiguration(const settings::LoadPage & s) {
+	QFileInfo keyInfo(s.clientSslKeyPath);
+	QFileInfo crtInfo(s.clientSslCrtPath);
+	QString key = (QStringList()
+		<< s.clientSslKeyPath << keyInfo.lastModified().toString(Qt::ISODate)
+		<< s.clientSslCrtPath << crtInfo.lastModified().toString(Qt::ISODate)
+		<< s.clientSslKeyPassword).join(QChar('\n'));
+	QHash<QString, QSslConfiguration>::const_iterator i = sslConfigurations.constFind(key);
+	if (i != sslConfigurations.constEnd()) return i.value();
+
+	//Failures are remembered as a null configuration
+	QSslConfiguration & sslConfig = sslConfigurations[key];
+	QFile keyFile(s.clientSslKeyPath);
+	if (!keyFile.open(QFile::ReadOnly)) return sslConfig;
+	QSslKey sslKey(&keyFile, QSsl::Rsa, QSsl::Pem, QSsl::PrivateKey, s.clientSslKeyPassword.toUtf8());
+	keyFile.close();
+
+	QList<QSslCertificate> chainCerts =
+		QSslCertificate::fromPath(s.clientSslCrtPath.toLatin1(),  QSsl::Pem, QRegExp::FixedString);
+	if (chainCerts.isEmpty()) return sslConfig;
+
+	QSslConfiguration config = QSslConfiguration::defaultConfiguration();
+	config.setPrivateKey(sslKey);
+	QList<QSslCertificate> cas = config.caCertificates();
+	cas.append(chainCerts);
+	config.setLocalCertificate(chainCerts.first());
+	config.setCaCertificates(cas);
+	sslConfig = config;
+	return config;
+}
+#endif
+
+/*!
+ * Remember a reply until it is done, so it can be aborted and its timing reported
+ *
+ * Qt does not tell when the name was resolved or the connection made, so only
+ * the time to the response headers and the time receiving the body are known.
+ */
+QNetworkReply * MyNetworkAccessManager::track(QNetworkReply * reply, ResourceObject * resource) {
+	replies.insert(reply, resource);
+	Timing & t = timings[reply];
+	t.timer.start();
+	t.timing.started = QDateTime::currentDateTime();
+	t.timing.url = reply->url().toString();
+	switch (reply->operation()) {
+	case HeadOperation: t.timing.method = "HEAD"; break;
+	case PutOperation: t.timing.method = "PUT"; break;
+	case PostOperation: t.timing.method = "POST"; break;
+	case DeleteOperation: t.timing.method = "DELETE"; break;
+	case CustomOperation:
+		t.timing.method = QString::fromLatin1(reply->request().attribute(QNetworkRequest::CustomVerbAttribute).toByteArray());
+		break;
+	default: t.timing.method = "GET"; break;
+	}
+	connect(reply, SIGNAL(metaDataChanged()), this, SLOT(replyResponded()));
+	connect(reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(replyProgress(qint64, qint64)));
+	connect(reply, SIGNAL(finished()), this, SLOT(replyFinished()));
+	connect(reply, SIGNAL(destroyed()), this, SLOT(replyDone()));
+	if (resource) resource->networkActivity(pending(resource));
+	return reply;
 }
 
 QNetworkReply * MyNetworkAccessManager::createRequest(Operation op, const QNetworkRequest & req, QIODevice * outgoingData) {
-	emit debug(QString("Creating request: ") + req.url().toString());
+	ResourceObject * resource = resourceFor(req.originatingObject());
+	if (!resource) {
+		// Without a resource there are no settings to check the request against
+		QNetworkRequest r2 = req;
+		r2.setUrl(QUrl("about:blank"));
+		return track(QNetworkAccessManager::createRequest(op, r2, outgoingData), 0);
+	}
+	const settings::LoadPage & settings = resource->settings;
+	resource->debug(QString("Creating request: ") + req.url().toString());
 
-	if (disposed)
+	if (disposed.contains(resource))
 	{
-		emit warning("Received createRequest signal on a disposed ResourceObject's NetworkAccessManager. "
+		resource->warning("Received createRequest signal on a disposed ResourceObject's NetworkAccessManager. "
 			     "This might be an indication of an iframe taking too long to load.");
 		// Needed to avoid race conditions by spurious network requests
 		// by scripts or iframes taking too long to load.
 		QNetworkRequest r2 = req;
 		r2.setUrl(QUrl("about:blank"));
-		return QNetworkAccessManager::createRequest(op, r2, outgoingData);
+		return track(QNetworkAccessManager::createRequest(op, r2, outgoingData), resource);
 	}
 
-	bool isLocalFileAccess = req.url().scheme().length() <= 1 || req.url().scheme() == "file";
-	if (isLocalFileAccess && settings.blockLocalFileAccess) {
-		bool ok=false;
-		QString path = QFileInfo(req.url().toLocalFile()).canonicalFilePath();
-		QString old = "";
-		while (path != old) {
-			if (allowed.contains(path)) {
-				ok=true;
-				break;
-			}
-			old = path;
-			path = QFileInfo(path).path();
-		}
-		if (!ok) {
-			QNetworkRequest r2 = req;
-			emit warning(QString("Blocked access to file %1").arg(QFileInfo(req.url().toLocalFile()).canonicalFilePath()));
+	const RequestRules::Rule * rule = resource->rules ? resource->rules->match(req.url()) : 0;
+	if (rule) {
+		QNetworkRequest r2 = req;
+		if (rule->action == RequestRules::block) {
+			resource->debug(QString("Blocked request to %1").arg(req.url().toString()));
 			r2.setUrl(QUrl("about:blank"));
-			return QNetworkAccessManager::createRequest(op, r2, outgoingData);
+		} else if (rule->action == RequestRules::rewrite) {
+			resource->debug(QString("Loading %1 instead of %2").arg(rule->argument, req.url().toString()));
+			r2.setUrl(QUrl::fromLocalFile(rule->argument));
+		} else {
+			resource->debug(QString("Stubbed out request to %1").arg(req.url().toString()));
+			r2.setUrl(QUrl("data:" + rule->argument + ","));
 		}
+		return track(QNetworkAccessManager::createRequest(op, r2, outgoingData), resource);
+	}
+
+	bool isLocalFileAccess = req.url().scheme().length() <= 1 || req.url().scheme() == "file";
+	if (isLocalFileAccess && settings.blockLocalFileAccess
+		&& !resource->allows(QFileInfo(req.url().toLocalFile()).canonicalFilePath())) {
+		QNetworkRequest r2 = req;
+		resource->warning(QString("Blocked access to file %1").arg(QFileInfo(req.url().toLocalFile()).canonicalFilePath()));
+		r2.setUrl(QUrl("about:blank"));
+		return track(QNetworkAccessManager::createRequest(op, r2, outgoingData), resource);
 	}
 	QNetworkRequest r3 = req;
 	if (settings.repeatCustomHeaders) {
@@ -116,29 +336,18 @@ QNetworkReply * MyNetworkAccessManager::createRequest(Operation op, const QNetwo
 	#if (QT_VERSION >= 0x050000 && !defined QT_NO_SSL) || !defined QT_NO_OPENSSL
 	if(!settings.clientSslKeyPath.isEmpty() && !settings.clientSslKeyPassword.isEmpty()
 			&& !settings.clientSslCrtPath.isEmpty()){
-		QSslConfiguration sslConfig = QSslConfiguration::defaultConfiguration();
-
-		QFile keyFile(settings.clientSslKeyPath);
-		if(keyFile.open(QFile::ReadOnly)){
-			QSslKey key(&keyFile, QSsl::Rsa, QSsl::Pem, QSsl::PrivateKey, settings.clientSslKeyPassword.toUtf8());
-			sslConfig.setPrivateKey(key);
-			keyFile.close();
-
-			QList<QSslCertificate> chainCerts =
-				QSslCertificate::fromPath(settings.clientSslCrtPath.toLatin1(),  QSsl::Pem, QRegExp::FixedString);
-			QList<QSslCertificate> cas =  sslConfig.caCertificates();
-			cas.append(chainCerts);
-			if(!chainCerts.isEmpty()){
-				sslConfig.setLocalCertificate(chainCerts.first());
-				sslConfig.setCaCertificates(cas);
-
-				r3.setSslConfiguration(sslConfig);
-			}
-		}
+		QSslConfiguration sslConfig = clientSslConfiguration(settings);
+		if (!sslConfig.isNull()) r3.setSslConfiguration(sslConfig);
 	}
 	#endif
 
-	return QNetworkAccessManager::createRequest(op, r3, outgoingData);
+	//The memory cache serves responses by url alone, do not keep those that
+	//may depend on who asked for them
+	if (qobject_cast<MemoryCache *>(cache()) && (r3.hasRawHeader("Authorization") || r3.hasRawHeader("Cookie") || !settings.username.isEmpty()
+		|| (cookieJar() && !cookieJar()->cookiesForUrl(r3.url()).isEmpty())))
+		r3.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+
+	return track(QNetworkAccessManager::createRequest(op, r3, outgoingData), resource);
 }
 
 MyNetworkProxyFactory::MyNetworkProxyFactory (QNetworkProxy proxy, QList<QString> bph):
@@ -155,6 +364,95 @@ QList<QNetworkProxy> MyNetworkProxyFactory::queryProxy (const QNetworkProxyQuery
 	return originalProxy;
 }
 
+const int PipeDevice::bufferLimit = 1024*1024;
+
+PipeDevice::PipeDevice(int f, QObject * parent):
+	QIODevice(parent), fd(f), notifier(0), eof(false), paused(false) {}
+
+/*!
+ * Start reading the pipe, only reading is supported
+ */
+bool PipeDevice::open(OpenMode mode) {
+	if ((mode & WriteOnly) || !QIODevice::open(mode | Unbuffered)) return false;
+	notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+	connect(notifier, SIGNAL(activated(int)), this, SLOT(fill()));
+	return true;
+}
+
+bool PipeDevice::isSequential() const {
+	return true;
+}
+
+bool PipeDevice::atEnd() const {
+	QMutexLocker locker(&mutex);
+	return eof && buffer.isEmpty();
+}
+
+qint64 PipeDevice::bytesAvailable() const {
+	QMutexLocker locker(&mutex);
+	return buffer.size() + QIODevice::bytesAvailable();
+}
+
+/*!
+ * Block until data arrives or the pipe is closed
+ */
+bool PipeDevice::waitForReadyRead(int) {
+	{
+		QMutexLocker locker(&mutex);
+		if (!buffer.isEmpty()) return true;
+		if (eof) return false;
+	}
+	fill();
+	QMutexLocker locker(&mutex);
+	return !buffer.isEmpty();
+}
+
+qint64 PipeDevice::readData(char * data, qint64 maxSize) {
+	QMutexLocker locker(&mutex);
+	if (buffer.isEmpty()) return eof ? -1 : 0;
+	qint64 n = qMin(maxSize, qint64(buffer.size()));
+	memcpy(data, buffer.constData(), n);
+	buffer.remove(0, n);
+	if (paused && buffer.size() < bufferLimit) {
+		paused = false;
+		//The notifier belongs to the thread of the device
+		QMetaObject::invokeMethod(this, "resume", Qt::QueuedConnection);
+	}
+	return n;
+}
+
+qint64 PipeDevice::writeData(const char *, qint64) {
+	return -1;
+}
+
+/*!
+ * Read what the pipe has, or block until it has something
+ */
+void PipeDevice::fill() {
+	char chunk[64*1024];
+	qint64 r = -1;
+#ifdef Q_OS_UNIX
+	do r = ::read(fd, chunk, sizeof(chunk)); while (r < 0 && errno == EINTR);
+#endif
+	QMutexLocker locker(&mutex);
+	if (r > 0) {
+		buffer.append(chunk, r);
+		paused = buffer.size() >= bufferLimit;
+	} else
+		eof = true;
+	if (notifier) notifier->setEnabled(!eof && !paused);
+	locker.unlock();
+	if (r > 0)
+		emit readyRead();
+	else
+		emit readChannelFinished();
+}
+
+void PipeDevice::resume() {
+	QMutexLocker locker(&mutex);
+	if (notifier) notifier->setEnabled(!eof && !paused);
+}
+
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 MyQWebPage::MyQWebPage(ResourceObject & res): resource(res) {}
 
@@ -194,83 +492,94 @@ QString MyQWebPage::overrideMediaType() const
 }
 #endif
 
-ResourceObject::ResourceObject(MultiPageLoaderPrivate & mpl, const QUrl & u, const settings::LoadPage & s):
-	networkAccessManager(s),
+ResourceObject::ResourceObject(MultiPageLoaderPrivate & mpl, const QUrl & u, const settings::LoadPage & s, QIODevice * c):
 	url(u),
+	content(c),
 	loginTry(0),
 	progress(0),
 	windowStatusCounter(0),
+#ifndef WKHTMLTOPDF_USE_WEBKIT
+	waitingForWindowStatus(false),
+#endif
 	finished(false),
 	signalPrint(false),
+	pendingRequests(0),
+	waitingForNetworkIdle(false),
+	timingsPending(false),
 	multiPageLoader(mpl),
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	webPage(*this),
 	lo(webPage),
+#else
+	renderPage(RenderPage::create(RenderEngineFactory::defaultBackend(), settings::Web(), s, &mpl)),
+	lo(*renderPage),
 #endif
 	httpErrorCode(0),
 	settings(s) {
 
-	connect(&networkAccessManager, SIGNAL(authenticationRequired(QNetworkReply*, QAuthenticator *)),this,
+	if (multiPageLoader.settings.shareConnections)
+		networkAccessManager = multiPageLoader.sharedNetworkAccessManager(s);
+	else
+		networkAccessManager = multiPageLoader.createNetworkAccessManager(s, this);
+#ifdef WKHTMLTOPDF_USE_WEBKIT
+	networkAccessManager->attach(this, &webPage);
+#else
+	networkAccessManager->attach(this, renderPage);
+#endif
+
+	connect(networkAccessManager, SIGNAL(authenticationRequired(QNetworkReply*, QAuthenticator *)),this,
 	        SLOT(handleAuthenticationRequired(QNetworkReply *, QAuthenticator *)));
+
+	jsDelayTimer.setSingleShot(true);
+	connect(&jsDelayTimer, SIGNAL(timeout()), this, SLOT(loadDone()));
+	windowStatusTimer.setSingleShot(true);
+	windowStatusTimer.setInterval(50);
+	connect(&windowStatusTimer, SIGNAL(timeout()), this, SLOT(waitWindowStatus()));
+	networkIdleTimer.setSingleShot(true);
+	connect(&networkIdleTimer, SIGNAL(timeout()), this, SLOT(networkIdle()));
+	networkIdleTimeoutTimer.setSingleShot(true);
+	connect(&networkIdleTimeoutTimer, SIGNAL(timeout()), this, SLOT(networkIdleTimeout()));
+
+	if (!s.requestRules.isEmpty()) {
+		QStringList errors;
+		rules = RequestRules::load(s.requestRules, &errors);
+		foreach (const QString & e, errors)
+			warning(e);
+	}
+
 	foreach (const QString & path, s.allowed)
-		networkAccessManager.allow(path);
-	if (url.scheme() == "file")
-		networkAccessManager.allow(url.toLocalFile());
+		allow(path);
+	if (content)
+		content->setParent(this);
+	else if (url.scheme() == "file")
+		allow(url.toLocalFile());
 
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	connect(&webPage, SIGNAL(loadStarted()), this, SLOT(loadStarted()));
 	connect(&webPage, SIGNAL(loadProgress(int)), this, SLOT(loadProgress(int)));
 	connect(&webPage, SIGNAL(loadFinished(bool)), this, SLOT(loadFinished(bool)));
 	connect(&webPage, SIGNAL(printRequested(QWebFrame*)), this, SLOT(printRequested(QWebFrame*)));
+#else
+	connect(renderPage, SIGNAL(loadStarted()), this, SLOT(loadStarted()));
+	connect(renderPage, SIGNAL(loadProgress(int)), this, SLOT(loadProgress(int)));
+	connect(renderPage, SIGNAL(loadFinished(bool)), this, SLOT(loadFinished(bool)));
+	connect(renderPage, SIGNAL(printRequested()), this, SLOT(printRequested()));
+	connect(renderPage, SIGNAL(windowStatusChanged(const QString &)), this, SLOT(windowStatusChanged(const QString &)));
+	connect(renderPage, SIGNAL(consoleMessage(const QString &, int, const QString &)),
+			this, SLOT(consoleMessage(const QString &, int, const QString &)));
+	connect(renderPage, SIGNAL(networkActivity(int)), this, SLOT(networkActivity(int)));
+	connect(renderPage, SIGNAL(idleChecked(bool)), this, SLOT(idleChecked(bool)));
 #endif
 
 	//If some ssl error occurs we want sslErrors to be called, so the we can ignore it
-	connect(&networkAccessManager, SIGNAL(sslErrors(QNetworkReply*, const QList<QSslError>&)),this,
+	connect(networkAccessManager, SIGNAL(sslErrors(QNetworkReply*, const QList<QSslError>&)),this,
 	        SLOT(sslErrors(QNetworkReply*, const QList<QSslError>&)));
 
-	connect(&networkAccessManager, SIGNAL(finished (QNetworkReply *)),
+	connect(networkAccessManager, SIGNAL(finished (QNetworkReply *)),
 			this, SLOT(amfinished (QNetworkReply *) ) );
 
-	connect(&networkAccessManager, SIGNAL(debug(const QString &)),
-			this, SLOT(debug(const QString &)));
-
-	connect(&networkAccessManager, SIGNAL(info(const QString &)),
-			this, SLOT(info(const QString &)));
-
-	connect(&networkAccessManager, SIGNAL(warning(const QString &)),
-			this, SLOT(warning(const QString &)));
-
-	connect(&networkAccessManager, SIGNAL(error(const QString &)),
-			this, SLOT(error(const QString &)));
-
-	networkAccessManager.setCookieJar(multiPageLoader.cookieJar);
-
-	//If we must use a proxy, create a host of objects
-	if (!settings.proxy.host.isEmpty()) {
-		QNetworkProxy proxy;
-		proxy.setHostName(settings.proxy.host);
-		proxy.setPort(settings.proxy.port);
-		proxy.setType(settings.proxy.type);
-
-		if (settings.proxy.type == QNetworkProxy::HttpProxy) {
-			QNetworkProxy::Capabilities capabilities = QNetworkProxy::CachingCapability | QNetworkProxy::TunnelingCapability;
-			if (settings.proxyHostNameLookup)
-				capabilities |= QNetworkProxy::HostNameLookupCapability;
-			proxy.setCapabilities(capabilities);
-		}
-		if (!settings.proxy.user.isEmpty())
-			proxy.setUser(settings.proxy.user);
-		if (!settings.proxy.password.isEmpty())
-			proxy.setPassword(settings.proxy.password);
-		if (!settings.bypassProxyForHosts.isEmpty())
-			networkAccessManager.setProxyFactory(
-				new MyNetworkProxyFactory(proxy, settings.bypassProxyForHosts));
-		else
-			networkAccessManager.setProxy(proxy);
-	}
-
 #ifdef WKHTMLTOPDF_USE_WEBKIT
-	webPage.setNetworkAccessManager(&networkAccessManager);
+	webPage.setNetworkAccessManager(networkAccessManager);
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 	double devicePixelRatio = multiPageLoader.dpi / 96.; // The used version of WebKit always renders at 96 DPI when no zoom is applied. It does not fully support a device pixel ratio != 1 natively.
 	webPage.mainFrame()->setZoomFactor(devicePixelRatio * settings.zoomFactor); // Zoom in the page to achieve a higher DPI.
@@ -279,6 +588,37 @@ ResourceObject::ResourceObject(MultiPageLoaderPrivate & mpl, const QUrl & u, con
 #endif
 }
 
+ResourceObject::~ResourceObject() {
+	//A shared manager may already be gone when the loader was deleted first
+	if (networkAccessManager)
+		networkAccessManager->detach(this);
+#ifndef WKHTMLTOPDF_USE_WEBKIT
+	//Hand the page back so the next conversion gets a warm one
+	RenderPage::release(renderPage);
+#endif
+}
+
+void ResourceObject::allow(QString path) {
+	QString x = QFileInfo(path).canonicalFilePath();
+	if (x.isEmpty()) return;
+	allowed.insert(x);
+}
+
+/*!
+ * Check if the resource may read a file, because it or a folder containing it was allowed
+ * \param path The canonical path of the file
+ */
+bool ResourceObject::allows(const QString & path) const {
+	QString p = path;
+	QString old = "";
+	while (p != old) {
+		if (allowed.contains(p)) return true;
+		old = p;
+		p = QFileInfo(p).path();
+	}
+	return false;
+}
+
 /*!
  * Once loading starting, this is called
  */
@@ -330,9 +670,7 @@ void ResourceObject::loadFinished(bool ok) {
 			error(QString("Failed loading page ") + url.toString() + " (sometimes it will work just to ignore this error with --load-error-handling ignore)");
 		else if (settings.loadErrorHandling == settings::LoadPage::skip) {
 			warning(QString("Failed loading page ") + url.toString() + " (skipped)");
-#ifdef WKHTMLTOPDF_USE_WEBKIT
 			lo.skip = true;
-#endif
 		} else
 			warning(QString("Failed loading page ") + url.toString() + " (ignored)");
 	}
@@ -344,21 +682,82 @@ void ResourceObject::loadFinished(bool ok) {
 	if (isMain)
 		foreach (const QString & str, settings.runScript)
 			webPage.mainFrame()->evaluateJavaScript(str);
+#else
+	if (isMain)
+		foreach (const QString & str, settings.runScript)
+			renderPage->evaluateJavaScript(str, JavaScriptCallback());
 #endif
 
 	// XXX: If loading failed there's no need to wait
 	//      for javascript on this resource.
-	if (!ok || signalPrint || settings.jsdelay == 0) loadDone();
+	if (!ok || signalPrint || (settings.jsdelay == 0 && settings.networkIdle <= 0)) loadDone();
 	else if (isMain && !settings.windowStatus.isEmpty()) waitWindowStatus();
-	else QTimer::singleShot(settings.jsdelay, this, SLOT(loadDone()));
+	else settle();
 }
 
-void ResourceObject::waitWindowStatus() {
+/*!
+ * Give scripts on the page time to finish, either a fixed delay or
+ * until the network has become idle
+ */
+void ResourceObject::settle() {
+	if (settings.networkIdle > 0) waitNetworkIdle();
+	else jsDelayTimer.start(settings.jsdelay);
+}
+
+void ResourceObject::waitNetworkIdle() {
+	waitingForNetworkIdle = true;
+	if (settings.networkIdleTimeout > 0)
+		networkIdleTimeoutTimer.start(settings.networkIdleTimeout);
+	if (pendingRequests == 0) networkIdleTimer.start(settings.networkIdle);
+}
+
+/*!
+ * Track the requests running, any activity restarts the quiet period
+ * \param pending the number of requests still running
+ */
+void ResourceObject::networkActivity(int pending) {
+	pendingRequests = pending;
+	if (!waitingForNetworkIdle || finished) return;
+	if (pending == 0) networkIdleTimer.start(settings.networkIdle);
+	else networkIdleTimer.stop();
+}
+
+/*!
+ * The network was quiet for long enough, see if the page agrees
+ */
+void ResourceObject::networkIdle() {
+	if (!waitingForNetworkIdle || finished) return;
 #ifdef WKHTMLTOPDF_USE_WEBKIT
-	QString windowStatus = webPage.mainFrame()->evaluateJavaScript("window.status").toString();
+	//QWebFrame cannot wait for fonts or animation frames, only the network
+	//is waited for, as the help of --network-idle says
+	idleChecked(true);
 #else
-	QString windowStatus = "";
+	renderPage->checkIdle();
 #endif
+}
+
+void ResourceObject::idleChecked(bool idle) {
+	if (!waitingForNetworkIdle || finished) return;
+	if (!idle) {
+		//Something is still loading, it will report when it is done
+		if (pendingRequests == 0) networkIdleTimer.start(settings.networkIdle);
+		return;
+	}
+	debug("Network idle, the page is ready.");
+	waitingForNetworkIdle = false;
+	loadDone();
+}
+
+void ResourceObject::networkIdleTimeout() {
+	if (!waitingForNetworkIdle || finished) return;
+	warning(QString("The network did not become idle within %1 ms, printing ").arg(settings.networkIdleTimeout) + url.toString() + " anyway");
+	waitingForNetworkIdle = false;
+	loadDone();
+}
+
+#ifdef WKHTMLTOPDF_USE_WEBKIT
+void ResourceObject::waitWindowStatus() {
+	QString windowStatus = webPage.mainFrame()->evaluateJavaScript("window.status").toString();
 	if (windowStatus != settings.windowStatus) {
 		// This is once a second
 		if ((++windowStatusCounter % 20) == 0) {
@@ -366,23 +765,59 @@ void ResourceObject::waitWindowStatus() {
 			debug(QString("Waiting for window.status; Found: \"" + windowStatus + "\", but expecting: \"" + settings.windowStatus + "\"."));
 		}
 
-		QTimer::singleShot(50, this, SLOT(waitWindowStatus()));
+		windowStatusTimer.start();
 	} else {
 		debug("Window status \"" + settings.windowStatus + "\" found.");
-		QTimer::singleShot(settings.jsdelay, this, SLOT(loadDone()));
+		settle();
+	}
+}
+#else
+/*!
+ * Wait for the page to assign the expected value to window.status, the
+ * page reports every assignment through windowStatusChanged
+ */
+void ResourceObject::waitWindowStatus() {
+	waitingForWindowStatus = true;
+	windowStatusChanged(windowStatus);
+}
+
+void ResourceObject::windowStatusChanged(const QString & status) {
+	windowStatus = status;
+	if (!waitingForWindowStatus || finished) return;
+	if (status != settings.windowStatus) {
+		debug(QString("Waiting for window.status; Found: \"" + status + "\", but expecting: \"" + settings.windowStatus + "\"."));
+		return;
 	}
+	waitingForWindowStatus = false;
+	debug("Window status \"" + settings.windowStatus + "\" found.");
+	settle();
 }
 
+void ResourceObject::consoleMessage(const QString & message, int lineNumber, const QString & sourceID) {
+	if (settings.debugJavascript)
+		info(QString("%1:%2 %3").arg(sourceID).arg(lineNumber).arg(message));
+}
+#endif
+
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 void ResourceObject::printRequested(QWebFrame *) {
         signalPrint=true;
         loadDone();
 }
+#else
+void ResourceObject::printRequested() {
+        signalPrint=true;
+        loadDone();
+}
 #endif
 
 void ResourceObject::loadDone() {
 	if (finished) return;
 	finished=true;
+	jsDelayTimer.stop();
+	windowStatusTimer.stop();
+	networkIdleTimer.stop();
+	networkIdleTimeoutTimer.stop();
 
 	debug("Loading done; Stopping QWebPage and any possible page refreshes.");
 
@@ -390,13 +825,67 @@ void ResourceObject::loadDone() {
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	webPage.triggerAction(QWebPage::Stop);
 	webPage.triggerAction(QWebPage::StopScheduledPageRefresh);
+#else
+	//Chromium does the networking, ask the page what its requests took.
+	//The loader is only done once the answer is in
+	QPointer<ResourceObject> self(this);
+	timingsPending = true;
+	++multiPageLoader.pendingTimings;
+	renderPage->networkTimings([self](const QList<NetworkTiming> & timings) {
+		if (self) self->timingsReported(timings);
+	});
+	renderPage->stop();
 #endif
-	networkAccessManager.dispose();
+	networkAccessManager->dispose(this);
 	//disconnect(this, 0, 0, 0);
 
 	--multiPageLoader.loading;
-	if (multiPageLoader.loading == 0)
-		multiPageLoader.loadDone();
+	multiPageLoader.loadNext();
+	multiPageLoader.resourceDone();
+}
+
+/*!
+ * The page has reported the timing of the requests it made
+ */
+void ResourceObject::timingsReported(const QList<NetworkTiming> & timings) {
+	if (!timingsPending) return;
+	timingsPending = false;
+	QString page = url.toString();
+	foreach (NetworkTiming timing, timings) {
+		timing.page = page;
+		multiPageLoader.networkTimings.append(timing);
+	}
+	--multiPageLoader.pendingTimings;
+	multiPageLoader.resourceDone();
+}
+
+/*!
+ * Record the timing of a request made for the resource
+ */
+void ResourceObject::requestDone(NetworkTiming timing) {
+	timing.page = url.toString();
+	multiPageLoader.networkTimings.append(timing);
+}
+
+/*!
+ * Stop all work on the resource right away, without reporting it as loaded
+ */
+void ResourceObject::cancel() {
+	jsDelayTimer.stop();
+	windowStatusTimer.stop();
+	networkIdleTimer.stop();
+	networkIdleTimeoutTimer.stop();
+	networkAccessManager->dispose(this);
+	networkAccessManager->abortAll(this);
+#ifdef WKHTMLTOPDF_USE_WEBKIT
+	webPage.triggerAction(QWebPage::Stop);
+	webPage.triggerAction(QWebPage::StopScheduledPageRefresh);
+#else
+	renderPage->stop();
+	//The loader no longer waits for the timings
+	timingsPending=false;
+#endif
+	finished=true;
 }
 
 /*!
@@ -404,7 +893,7 @@ void ResourceObject::loadDone() {
  * and password supplied on the command line
  */
 void ResourceObject::handleAuthenticationRequired(QNetworkReply *reply, QAuthenticator *authenticator) {
-	Q_UNUSED(reply);
+	if (networkAccessManager->resourceFor(reply) != this) return;
 
 	// XXX: Avoid calling 'reply->abort()' from within this signal.
 	//      As stated by doc, request would be finished when no
@@ -446,6 +935,7 @@ void ResourceObject::error(const QString & str) {
  * \param reply The networkreply that has finished
  */
 void ResourceObject::amfinished(QNetworkReply * reply) {
+	if (networkAccessManager->resourceFor(reply) != this) return;
 	debug(QString("Finished request: ") + reply->url().toString());
 
 	int networkStatus = reply->error();
@@ -487,6 +977,7 @@ void ResourceObject::amfinished(QNetworkReply * reply) {
  * Handle any ssl error by ignoring
  */
 void ResourceObject::sslErrors(QNetworkReply *reply, const QList<QSslError> &) {
+	if (networkAccessManager->resourceFor(reply) != this) return;
 	//We ignore any ssl error, as it is next to impossible to send or receive
 	//any private information with wkhtmltopdf anyhow, seeing as you cannot authenticate
 	reply->ignoreSslErrors();
@@ -495,44 +986,18 @@ void ResourceObject::sslErrors(QNetworkReply *reply, const QList<QSslError> &) {
 
 void ResourceObject::load() {
 	finished=false;
+	pendingRequests=0;
+	waitingForNetworkIdle=false;
+#ifndef WKHTMLTOPDF_USE_WEBKIT
+	windowStatus.clear();
+	waitingForWindowStatus = false;
+#endif
 	++multiPageLoader.loading;
 
 	bool hasFiles=false;
 	foreach (const settings::PostItem & pi, settings.post) hasFiles |= pi.file;
 	QByteArray postData;
-	QString boundary;
-	if (hasFiles) {
-		boundary = QUuid::createUuid().toString().remove('-').remove('{').remove('}');
-		foreach (const settings::PostItem & pi, settings.post) {
-			//TODO escape values here
-			postData.append("--");
-			postData.append(boundary);
-			postData.append("\ncontent-disposition: form-data; name=\"");
-			postData.append(pi.name);
-			postData.append('\"');
-			if (pi.file) {
-				QFile f(pi.value);
-				if (!f.open(QIODevice::ReadOnly) ) {
-					error(QString("Unable to open file ")+pi.value);
-					multiPageLoader.fail();
-				}
-				postData.append("; filename=\"");
-				postData.append( QFileInfo(pi.value).fileName());
-				postData.append("\"\n\n");
-				postData.append( f.readAll() );
-				//TODO ADD MIME TYPE
-			} else {
-				postData.append("\n\n");
-				postData.append(pi.value);
-			}
-			postData.append('\n');
-		}
-		if (!postData.isEmpty()) {
-			postData.append("--");
-			postData.append(boundary);
-			postData.append("--\n");
-		}
-	} else {
+	if (!hasFiles) {
 #if QT_VERSION >= 0x050000
 		QUrlQuery q;
 		foreach (const settings::PostItem & pi, settings.post)
@@ -552,19 +1017,124 @@ void ResourceObject::load() {
  	foreach (const SSP & pair, settings.cookies)
 		multiPageLoader.cookieJar->useCookie(url, pair.first, pair.second);
 
+	if (content) {
+		loadContent(content);
+		return;
+	}
+
 	QNetworkRequest r = QNetworkRequest(url);
 	typedef QPair<QString, QString> HT;
 	foreach (const HT & j, settings.customHeaders)
 		r.setRawHeader(j.first.toLatin1(), j.second.toLatin1());
 
+	if (hasFiles) {
+		postFiles(r);
+		return;
+	}
+
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	if (postData.isEmpty())
 		webPage.mainFrame()->load(r);
-	else {
-		if (hasFiles)
-			r.setHeader(QNetworkRequest::ContentTypeHeader, QString("multipart/form-data, boundary=")+boundary);
+	else
 		webPage.mainFrame()->load(r, QNetworkAccessManager::PostOperation, postData);
+#else
+	renderPage->load(r, postData, LoadCallback());
+#endif
+}
+
+/*!
+ * Load a document from a device, relative links in it resolve against the url
+ */
+void ResourceObject::loadContent(QIODevice * device) {
+#ifdef WKHTMLTOPDF_USE_WEBKIT
+	QByteArray html;
+	do html.append(device->readAll()); while (device->waitForReadyRead(-1));
+	webPage.mainFrame()->setContent(html, "text/html", url);
+#else
+	if (!renderPage->setContent(device, url, LoadCallback()))
+		spoolContent(device);
+#endif
+}
+
+/*!
+ * Post a form with files through the network access manager and load the response
+ *
+ * The renderers only take a post body held in memory, the multipart body
+ * built here reads the files while they are sent.
+ */
+void ResourceObject::postFiles(QNetworkRequest request) {
+	QHttpMultiPart * multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+	foreach (const settings::PostItem & pi, settings.post) {
+		QHttpPart part;
+		QString disposition = QString("form-data; name=\"%1\"").arg(pi.name);
+		if (pi.file) {
+			QFile * f = new QFile(pi.value, multiPart);
+			if (!f->open(QIODevice::ReadOnly) ) {
+				error(QString("Unable to open file ")+pi.value);
+				multiPageLoader.fail();
+				delete multiPart;
+				return;
+			}
+			disposition += QString("; filename=\"%1\"").arg(QFileInfo(pi.value).fileName());
+			part.setBodyDevice(f);
+		} else
+			part.setBody(pi.value.toUtf8());
+		part.setHeader(QNetworkRequest::ContentDispositionHeader, disposition);
+		multiPart->append(part);
+	}
+
+#ifdef WKHTMLTOPDF_USE_WEBKIT
+	request.setOriginatingObject(&webPage);
+#else
+	request.setOriginatingObject(renderPage);
+#endif
+	QNetworkReply * reply = networkAccessManager->post(request, multiPart);
+	multiPart->setParent(reply);
+	connect(reply, SIGNAL(finished()), this, SLOT(postFinished()));
+}
+
+/*!
+ * The response of the form posted by postFiles arrived, errors are reported by amfinished
+ */
+void ResourceObject::postFinished() {
+	QNetworkReply * reply = static_cast<QNetworkReply *>(sender());
+	reply->deleteLater();
+	if (finished || reply->error() == QNetworkReply::OperationCanceledError) return;
+	if (!reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid()) {
+		loadFinished(false);
+		return;
 	}
+	QBuffer * response = new QBuffer(this);
+	response->setData(reply->readAll());
+	response->open(QIODevice::ReadOnly);
+	url = reply->url();
+	loadContent(response);
+}
+
+/*!
+ * Load the content through a temporary file, for backends that cannot read it from the device
+ */
+void ResourceObject::spoolContent(QIODevice * device) {
+	QString path = multiPageLoader.tempIn.create(".html");
+	QFile tmp(path);
+	if (!tmp.open(QIODevice::WriteOnly)) {
+		error("Unable to create temporary file");
+		multiPageLoader.fail();
+		return;
+	}
+	QByteArray buf(1024*1024, 0);
+	qint64 r;
+	while ((r = device->read(buf.data(), buf.size())) > 0 || device->waitForReadyRead(-1)) {
+		if (r > 0 && tmp.write(buf.data(), r) != r) {
+			error("Unable to write temporary file");
+			multiPageLoader.fail();
+			return;
+		}
+	}
+	tmp.close();
+	allow(path);
+#ifndef WKHTMLTOPDF_USE_WEBKIT
+	renderPage->load(QUrl::fromLocalFile(path), LoadCallback());
 #endif
 }
 
@@ -597,6 +1167,15 @@ void MyCookieJar::saveToFile(const QString & path) {
 		}
 }
 
+/*!
+ * A resource has finished loading or reported its timings, once every
+ * resource has done both the load is done
+ */
+void MultiPageLoaderPrivate::resourceDone() {
+	if (loading == 0 && nextResource >= resources.size() && pendingTimings == 0)
+		loadDone();
+}
+
 void MultiPageLoaderPrivate::loadDone() {
 	 if (!settings.cookieJar.isEmpty())
 	 	cookieJar->saveToFile(settings.cookieJar);
@@ -638,19 +1217,52 @@ MultiPageLoaderPrivate::MultiPageLoaderPrivate(const settings::LoadGlobal & s, i
 
 	if (!settings.cookieJar.isEmpty())
 		cookieJar->loadFromFile(settings.cookieJar);
+
+	if (settings.memoryCacheSize > 0) {
+		qint64 budget = qint64(settings.memoryCacheSize) * 1024 * 1024;
+		memoryCache = settings.shareMemoryCache ?
+			MemoryCache::sharedStore(budget) :
+			QSharedPointer<MemoryCache::Store>(new MemoryCache::Store(budget));
+	}
 }
 
 MultiPageLoaderPrivate::~MultiPageLoaderPrivate() {
 	clearResources();
 }
 
-#ifdef WKHTMLTOPDF_USE_WEBKIT
-LoaderObject * MultiPageLoaderPrivate::addResource(const QUrl & url, const settings::LoadPage & page) {
-        ResourceObject * ro = new ResourceObject(*this, url, page);
+LoaderObject * MultiPageLoaderPrivate::addResource(const QUrl & url, const settings::LoadPage & page, QIODevice * content) {
+        ResourceObject * ro = new ResourceObject(*this, url, page, content);
         resources.push_back(ro);
         return &ro->lo;
 }
-#endif
+
+/*!
+ * Get the network access manager resources with the given settings share
+ *
+ * Resources agreeing on the cache and the proxy load through the same manager,
+ * and so reuse each others connections to a host.
+ */
+MyNetworkAccessManager * MultiPageLoaderPrivate::sharedNetworkAccessManager(const settings::LoadPage & page) {
+	QString key = MyNetworkAccessManager::shareKey(page);
+	MyNetworkAccessManager * manager = networkAccessManagers.value(key);
+	if (!manager) {
+		manager = createNetworkAccessManager(page, this);
+		networkAccessManagers[key] = manager;
+	}
+	return manager;
+}
+
+/*!
+ * Create a network access manager using the cookie jar, and unless a cache directory
+ * is given the memory cache
+ */
+MyNetworkAccessManager * MultiPageLoaderPrivate::createNetworkAccessManager(const settings::LoadPage & page, QObject * parent) {
+	MyNetworkAccessManager * manager = new MyNetworkAccessManager(page, parent);
+	manager->setCookieJar(cookieJar);
+	if (page.cacheDir.isEmpty() && memoryCache)
+		manager->setCache(new MemoryCache(memoryCache));
+	return manager;
+}
 
 void MultiPageLoaderPrivate::load() {
 	progressSum=0;
@@ -658,14 +1270,26 @@ void MultiPageLoaderPrivate::load() {
 	finishedEmitted=false;
 	hasError=false;
 	loading=0;
+	nextResource=0;
+	pendingTimings=0;
+	networkTimings.clear();
 
-	for (int i=0; i < resources.size(); ++i)
-		resources[i]->load();
+	loadNext();
 
 	if (resources.size() == 0) loadDone();
 }
 
+/*!
+ * Start loading resources in order until maxParallelPages are loading
+ */
+void MultiPageLoaderPrivate::loadNext() {
+	while (nextResource < resources.size() &&
+		   (settings.maxParallelPages <= 0 || loading < settings.maxParallelPages))
+		resources[nextResource++]->load();
+}
+
 void MultiPageLoaderPrivate::clearResources() {
+	cancel();
 	while (resources.size() > 0)
 	{
 		// XXX: Using deleteLater() to dispose
@@ -680,9 +1304,16 @@ void MultiPageLoaderPrivate::clearResources() {
 	tempIn.removeAll();
 }
 
+/*!
+ * Stop loading, no resources are started or reported as loaded after this
+ */
 void MultiPageLoaderPrivate::cancel() {
-	//foreach (QWebPage * page, pages)
-	//	page->triggerAction(QWebPage::Stop);
+	nextResource = resources.size();
+	loading = 0;
+	pendingTimings = 0;
+	foreach (ResourceObject * resource, resources)
+		resource->cancel();
+	tempIn.removeAll();
 }
 
 void MultiPageLoaderPrivate::fail() {
@@ -710,25 +1341,26 @@ MultiPageLoader::~MultiPageLoader() {
   \brief Add a resource, to be loaded described by a string
   @param string Url describing the resource to load
 */
-#ifdef WKHTMLTOPDF_USE_WEBKIT
 LoaderObject * MultiPageLoader::addResource(const QString & string, const settings::LoadPage & s, const QString * data) {
 	QString url=string;
 	if (data && !data->isEmpty()) {
-		url = d->tempIn.create(".html");
-		QFile tmp(url);
-		if (!tmp.open(QIODevice::WriteOnly) || tmp.write(data->toUtf8())==0) {
-			emit error("Unable to create temporary file");
-			return NULL;
-		}
+		//Relative links in the data resolve against the working directory
+		QBuffer * content = new QBuffer();
+		content->setData(data->toUtf8());
+		content->open(QIODevice::ReadOnly);
+		return d->addResource(QUrl::fromLocalFile(QDir::currentPath() + "/"), s, content);
 	} else if (url == "-") {
+		//Stream the document, so it is rendered while it is still being written
+#ifdef Q_OS_UNIX
+		PipeDevice * content = new PipeDevice(STDIN_FILENO);
+#else
 		QFile in;
 		in.open(stdin,QIODevice::ReadOnly);
-		url = d->tempIn.create(".html");
-		QFile tmp(url);
-		if (!tmp.open(QIODevice::WriteOnly) || !copyFile(in, tmp)) {
-			emit error("Unable to create temporary file");
-			return NULL;
-		}
+		QBuffer * content = new QBuffer();
+		content->setData(in.readAll());
+#endif
+		content->open(QIODevice::ReadOnly);
+		return d->addResource(QUrl::fromLocalFile(QDir::currentPath() + "/"), s, content);
 	}
 	return addResource(guessUrlFromString(url), s);
 }
@@ -740,7 +1372,6 @@ LoaderObject * MultiPageLoader::addResource(const QString & string, const settin
 LoaderObject * MultiPageLoader::addResource(const QUrl & url, const settings::LoadPage & s) {
 	return d->addResource(url, s);
 }
-#endif
 
 /*!
   \brief Guess a url, by looking at a string
@@ -815,6 +1446,23 @@ int MultiPageLoader::httpErrorCode() {
 	return res;
 }
 
+/*!
+  \brief Return the timing of every request made while loading the resources
+
+  Pages rendered by WebEngine report their requests once they are done
+  loading, iframes excluded.
+*/
+QList<NetworkTiming> MultiPageLoader::networkTimings() const {
+	return d->networkTimings;
+}
+
+/*!
+  \brief Keep responses in the memory cache of another loader of the same conversion
+*/
+void MultiPageLoader::shareMemoryCache(const MultiPageLoader & other) {
+	d->memoryCache = other.d->memoryCache;
+}
+
 /*!
   \brief Begin loading all the resources added
 */
@@ -35,11 +35,13 @@
 #endif
 
 #include <loadsettings.hh>
+#include <networktiming.hh>
 
 #include <dllbegin.inc>
 namespace wkhtmltopdf {
 
 class DLL_LOCAL MyQWebPage;
+class DLL_PUBLIC RenderPage;
 
 class DLL_LOCAL LoaderObject {
 public:
@@ -49,7 +51,10 @@ public:
 
         LoaderObject(QWebPage & page);
 #else
-        LoaderObject() = default;
+        RenderPage & page;
+        bool skip;
+
+        LoaderObject(RenderPage & page);
 #endif
 };
 
@@ -59,12 +64,12 @@ class DLL_LOCAL MultiPageLoader: public QObject {
 public:
 	MultiPageLoader(settings::LoadGlobal & s, int dpi, bool mainLoader = false);
 	~MultiPageLoader();
-#ifdef WKHTMLTOPDF_USE_WEBKIT
 	LoaderObject * addResource(const QString & url, const settings::LoadPage & settings, const QString * data=NULL);
 	LoaderObject * addResource(const QUrl & url, const settings::LoadPage & settings);
-#endif
 	static QUrl guessUrlFromString(const QString &string);
 	int httpErrorCode();
+	QList<NetworkTiming> networkTimings() const;
+	void shareMemoryCache(const MultiPageLoader & other);
 	static bool copyFile(QFile & src, QFile & dst);
 public slots:
 	void load();
@@ -21,15 +21,29 @@
 #ifndef __MULTIPAGELOADER_P_HH__
 #define __MULTIPAGELOADER_P_HH__
 
+#include "memorycache.hh"
 #include "multipageloader.hh"
+#include "renderengine.hh"
+#include "requestrules.hh"
 #include "tempfile.hh"
 #include <QAtomicInt>
 #include <QAuthenticator>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QIODevice>
+#include <QMutex>
 #include <QNetworkAccessManager>
 #include <QNetworkCookieJar>
 #include <QNetworkReply>
+#include <QPointer>
+#include <QSet>
+#include <QSocketNotifier>
+#if (QT_VERSION >= 0x050000 && !defined QT_NO_SSL) || !defined QT_NO_OPENSSL
+#include <QSslConfiguration>
+#endif
+#include <QTimer>
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 #include <QWebFrame>
 #endif
@@ -47,26 +61,84 @@ public:
 	QList<QNetworkProxy> queryProxy (const QNetworkProxyQuery & query);
 };
 
+class DLL_LOCAL MultiPageLoaderPrivate;
+class DLL_LOCAL ResourceObject;
+
+/*!
+  \brief Network access manager serving one or more resources
+
+  Requests are matched to the resource they are made for through the object
+  they originate from, so the file access checks and the custom headers of
+  that resource are applied even when several resources share the manager.
+*/
 class DLL_LOCAL MyNetworkAccessManager: public QNetworkAccessManager {
 	Q_OBJECT
 private:
-	bool disposed;
-	QSet<QString> allowed;
-	const settings::LoadPage & settings;
+	//Resources loading through this manager, by the object their requests originate from
+	QHash<QObject *, ResourceObject *> origins;
+	QSet<ResourceObject *> disposed;
+	//Replies that have not finished yet, and the resource they were made for
+	QHash<QNetworkReply *, ResourceObject *> replies;
+	struct Timing {
+		NetworkTiming timing;
+		QElapsedTimer timer;
+	};
+	QHash<QNetworkReply *, Timing> timings;
+#if (QT_VERSION >= 0x050000 && !defined QT_NO_SSL) || !defined QT_NO_OPENSSL
+	//Client certificate configurations shared by all pages, see clientSslConfiguration
+	static QHash<QString, QSslConfiguration> sslConfigurations;
+	static QSslConfiguration clientSslConfiguration(const settings::LoadPage & s);
+#endif
+	int pending(ResourceObject * resource) const;
+	QNetworkReply * track(QNetworkReply * reply, ResourceObject * resource);
 public:
-	void dispose();
-	void allow(QString path);
-	MyNetworkAccessManager(const settings::LoadPage & s);
+	MyNetworkAccessManager(const settings::LoadPage & s, QObject * parent=0);
+	static QString shareKey(const settings::LoadPage & s);
+	void attach(ResourceObject * resource, QObject * origin);
+	void detach(ResourceObject * resource);
+	void dispose(ResourceObject * resource);
+	void abortAll(ResourceObject * resource);
+	ResourceObject * resourceFor(QObject * origin) const;
+	ResourceObject * resourceFor(QNetworkReply * reply) const;
 	QNetworkReply * createRequest(Operation op, const QNetworkRequest & req, QIODevice * outgoingData = 0);
-signals:
-	void debug(const QString & text);
-	void info(const QString & text);
-	void warning(const QString & text);
-	void error(const QString & text);
+private slots:
+	void replyFinished();
+	void replyDone();
+	void replyResponded();
+	void replyProgress(qint64 received, qint64 total);
 };
 
-class DLL_LOCAL MultiPageLoaderPrivate;
-class DLL_LOCAL ResourceObject;
+/*!
+  \brief Sequential device reading a pipe as data arrives
+
+  The renderer may read the device from another thread, so the buffer is
+  guarded by a mutex. At most bufferLimit bytes are read ahead of the reader.
+*/
+class DLL_LOCAL PipeDevice: public QIODevice {
+	Q_OBJECT
+private:
+	int fd;
+	QSocketNotifier * notifier;
+	mutable QMutex mutex;
+	QByteArray buffer;
+	bool eof;
+	//Reading stopped because the buffer is full
+	bool paused;
+public:
+	static const int bufferLimit;
+	PipeDevice(int fd, QObject * parent=0);
+	bool open(OpenMode mode);
+	bool isSequential() const;
+	bool atEnd() const;
+	qint64 bytesAvailable() const;
+	bool waitForReadyRead(int msecs);
+protected:
+	qint64 readData(char * data, qint64 maxSize);
+	qint64 writeData(const char * data, qint64 maxSize);
+private slots:
+	void fill();
+	void resume();
+};
 
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 class DLL_LOCAL MyQWebPage: public QWebPage {
@@ -88,32 +160,75 @@ public slots:
 class DLL_LOCAL ResourceObject: public QObject {
 	Q_OBJECT
 private:
-	MyNetworkAccessManager networkAccessManager;
+	QPointer<MyNetworkAccessManager> networkAccessManager;
+	//Canonical paths of the files and folders the resource may read
+	QSet<QString> allowed;
 	QUrl url;
+	//Document to load instead of url, which is then only its base url
+	QIODevice * content;
 	int loginTry;
 	int progress;
 	int windowStatusCounter;
+#ifndef WKHTMLTOPDF_USE_WEBKIT
+	//Last value the page assigned to window.status
+	QString windowStatus;
+	bool waitingForWindowStatus;
+#endif
 	bool finished;
 	bool signalPrint;
+	QTimer jsDelayTimer;
+	QTimer windowStatusTimer;
+	//Restarted on every bit of network activity, fires once the network was quiet long enough
+	QTimer networkIdleTimer;
+	QTimer networkIdleTimeoutTimer;
+	int pendingRequests;
+	bool waitingForNetworkIdle;
+	//The network timings were asked for and have not been reported yet
+	bool timingsPending;
 	MultiPageLoaderPrivate & multiPageLoader;
 public:
-	ResourceObject(MultiPageLoaderPrivate & mpl, const QUrl & u, const settings::LoadPage & s);
+	ResourceObject(MultiPageLoaderPrivate & mpl, const QUrl & u, const settings::LoadPage & s, QIODevice * c=0);
+	~ResourceObject();
+	void cancel();
+	void allow(QString path);
+	bool allows(const QString & path) const;
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	MyQWebPage webPage;
 	LoaderObject lo;
+#else
+	RenderPage * renderPage;
+	LoaderObject lo;
 #endif
 	int httpErrorCode;
 	const settings::LoadPage settings;
+	//Compiled rules of settings.requestRules, or null
+	QSharedPointer<RequestRules> rules;
 public slots:
 	void load();
+	void loadContent(QIODevice * device);
+	void spoolContent(QIODevice * device);
+	void postFiles(QNetworkRequest request);
+	void postFinished();
 	void loadStarted();
 	void loadProgress(int progress);
 	void loadFinished(bool ok);
 	void waitWindowStatus();
+	void settle();
+	void waitNetworkIdle();
+	void networkActivity(int pending);
+	void networkIdle();
+	void idleChecked(bool idle);
+	void networkIdleTimeout();
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	void printRequested(QWebFrame * frame);
+#else
+	void printRequested();
+	void windowStatusChanged(const QString & status);
+	void consoleMessage(const QString & message, int lineNumber, const QString & sourceID);
 #endif
 	void loadDone();
+	void requestDone(NetworkTiming timing);
+	void timingsReported(const QList<NetworkTiming> & timings);
 	void handleAuthenticationRequired(QNetworkReply *reply, QAuthenticator *authenticator);
 	void debug(const QString & str);
 	void info(const QString & str);
@@ -143,8 +258,18 @@ public:
 	const settings::LoadGlobal settings;
 
 	QList<ResourceObject *> resources;
+	//Managers shared by the resources when connections are shared, by MyNetworkAccessManager::shareKey
+	QHash<QString, MyNetworkAccessManager *> networkAccessManagers;
+	//Timings of the requests made since load was called
+	QList<NetworkTiming> networkTimings;
+	//Where the memory caches of the managers keep responses, if enabled
+	QSharedPointer<MemoryCache::Store> memoryCache;
 
 	int loading;
+	//Resources that are done loading but have not reported their network timings
+	int pendingTimings;
+	//Index of the next resource to start loading
+	int nextResource;
 	int progressSum;
 	bool isMainLoader;
 	bool loadStartedEmitted;
@@ -155,10 +280,12 @@ public:
 
         MultiPageLoaderPrivate(const settings::LoadGlobal & settings, int dpi, MultiPageLoader & o);
         ~MultiPageLoaderPrivate();
-#ifdef WKHTMLTOPDF_USE_WEBKIT
-        LoaderObject * addResource(const QUrl & url, const settings::LoadPage & settings);
-#endif
+        LoaderObject * addResource(const QUrl & url, const settings::LoadPage & settings, QIODevice * content=0);
+        MyNetworkAccessManager * createNetworkAccessManager(const settings::LoadPage & settings, QObject * parent);
+        MyNetworkAccessManager * sharedNetworkAccessManager(const settings::LoadPage & settings);
         void load();
+        void loadNext();
+        void resourceDone();
         void clearResources();
         void cancel();
 public slots:
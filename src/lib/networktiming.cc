@@ -0,0 +1,131 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "networktiming.hh"
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+#define STRINGIZE_(x) #x
+#define STRINGIZE(x) STRINGIZE_(x)
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+/*!
+  \file networktiming.hh
+  \brief Defines the NetworkTiming class
+*/
+
+NetworkTiming::NetworkTiming():
+	method("GET"), status(0), dns(-1), connect(-1), ssl(-1), wait(-1), receive(-1), bytes(-1) {}
+
+/*!
+ * Get the time from the start of the request until the response was received
+ */
+qreal NetworkTiming::total() const {
+	return qMax(dns, qreal(0)) + qMax(connect, qreal(0)) + qMax(wait, qreal(0)) + qMax(receive, qreal(0));
+}
+
+/*!
+ * Write timings as a HAR log, with a page for every page the requests were made for
+ *
+ * Headers, cookies and bodies are not recorded, so only the fields tools
+ * require of them are filled in.
+ */
+QByteArray NetworkTiming::toHar(const QList<NetworkTiming> & timings) {
+	QStringList pageIds;
+	QHash<QString, QDateTime> pageStarts;
+	QJsonArray entries;
+	foreach (const NetworkTiming & t, timings) {
+		if (!pageStarts.contains(t.page)) pageIds << t.page;
+		if (!pageStarts.contains(t.page) || t.started < pageStarts[t.page])
+			pageStarts[t.page] = t.started;
+
+		QJsonObject request;
+		request["method"] = t.method;
+		request["url"] = t.url;
+		request["httpVersion"] = QString();
+		request["cookies"] = QJsonArray();
+		request["headers"] = QJsonArray();
+		request["queryString"] = QJsonArray();
+		request["headersSize"] = -1;
+		request["bodySize"] = -1;
+
+		QJsonObject content;
+		content["size"] = t.bytes;
+		content["mimeType"] = QString();
+		QJsonObject response;
+		response["status"] = t.status;
+		response["statusText"] = QString();
+		response["httpVersion"] = QString();
+		response["cookies"] = QJsonArray();
+		response["headers"] = QJsonArray();
+		response["content"] = content;
+		response["redirectURL"] = QString();
+		response["headersSize"] = -1;
+		response["bodySize"] = t.bytes;
+
+		QJsonObject phases;
+		phases["blocked"] = -1;
+		phases["dns"] = t.dns;
+		phases["connect"] = t.connect;
+		phases["ssl"] = t.ssl;
+		phases["send"] = 0;
+		phases["wait"] = qMax(t.wait, qreal(0));
+		phases["receive"] = qMax(t.receive, qreal(0));
+
+		QJsonObject entry;
+		entry["pageref"] = QString("page_%1").arg(pageIds.indexOf(t.page) + 1);
+		entry["startedDateTime"] = t.started.toUTC().toString(Qt::ISODateWithMs);
+		entry["time"] = t.total();
+		entry["request"] = request;
+		entry["response"] = response;
+		entry["cache"] = QJsonObject();
+		entry["timings"] = phases;
+		entries.append(entry);
+	}
+
+	QJsonArray pages;
+	for (int i=0; i < pageIds.size(); ++i) {
+		QJsonObject page;
+		page["startedDateTime"] = pageStarts[pageIds[i]].toUTC().toString(Qt::ISODateWithMs);
+		page["id"] = QString("page_%1").arg(i + 1);
+		page["title"] = pageIds[i];
+		page["pageTimings"] = QJsonObject();
+		pages.append(page);
+	}
+
+	QJsonObject creator;
+	creator["name"] = QString("wkhtmltopdf");
+	creator["version"] = QString(STRINGIZE(FULL_VERSION));
+	QJsonObject log;
+	log["version"] = QString("1.2");
+	log["creator"] = creator;
+	log["pages"] = pages;
+	log["entries"] = entries;
+	QJsonObject root;
+	root["log"] = log;
+	return QJsonDocument(root).toJson();
+}
+
+}
+#include "dllend.inc"
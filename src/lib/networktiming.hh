@@ -0,0 +1,64 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __NETWORKTIMING_HH__
+#define __NETWORKTIMING_HH__
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QString>
+
+#include <dllbegin.inc>
+namespace wkhtmltopdf {
+
+/*!
+  \brief Timing of one request made while loading a page
+
+  Durations are in milliseconds, the phases a backend cannot observe are -1.
+  A connect time includes the ssl handshake, as in the HAR format.
+*/
+class DLL_PUBLIC NetworkTiming {
+public:
+	//Url of the page the request was made for
+	QString page;
+	QString url;
+	QString method;
+	//Http status code, 0 if there was no http response
+	int status;
+	QDateTime started;
+	qreal dns;
+	qreal connect;
+	qreal ssl;
+	//Time to the first byte of the response, after the request was sent
+	qreal wait;
+	//Time spent receiving the response
+	qreal receive;
+	//Bytes received, headers included when the backend can tell
+	qint64 bytes;
+
+	NetworkTiming();
+	qreal total() const;
+	static QByteArray toHar(const QList<NetworkTiming> & timings);
+};
+
+}
+#include <dllend.inc>
+#endif //__NETWORKTIMING_HH__
@@ -59,7 +59,7 @@ void OutlineItem::fillAnchors(const OutlineItem * other,
 
 	if (other) {
 		anchor = other->anchor;
-		tocAnchor = other->anchor;
+		tocAnchor = other->tocAnchor;
 	} else {
 		anchor = QString("__WKANCHOR_")+QString::number(anchorCounter++,36);
 		tocAnchor = QString("__WKANCHOR_")+QString::number(anchorCounter++,36);
@@ -272,6 +272,60 @@ void Outline::addEmptyWebPage() {
 	d->documentPages.push_back(1);
 }
 
+/*!
+  \brief Put the outline of a table of content in place before it is rendered
+
+  The table of content made by the default style sheet lists its own
+  caption. The entry for it is added here, along with the number of pages
+  the table of content is expected to take, so the outline does not change
+  when the table of content is rendered if the guess was right.
+  \param document The number of the table of content
+  \param ps The settings of the table of content
+  \param pages The number of pages to reserve
+*/
+void Outline::reserveTableOfContent(int document, const settings::PdfObject & ps, int pages) {
+	OutlineItem * root = d->documentOutlines[document];
+	foreach (OutlineItem * i, root->children)
+		delete i;
+	root->children.clear();
+	root->value = ps.toc.captionText;
+
+	QString value = QString(ps.toc.captionText).replace("\n", " ").trimmed();
+	if (!value.isEmpty()) {
+		OutlineItem * item = new OutlineItem();
+		item->parent = root;
+		item->page = 1;
+		item->document = document;
+		item->value = value;
+		item->forwardLinks = ps.toc.forwardLinks;
+		item->backLinks = ps.toc.backLinks;
+		item->anchor = QString("__WKANCHOR_")+QString::number(d->anchorCounter++,36);
+		item->tocAnchor = QString("__WKANCHOR_")+QString::number(d->anchorCounter++,36);
+		root->children.push_back(item);
+	}
+
+	d->pageCount += pages - d->documentPages[document];
+	d->documentPages[document] = pages;
+}
+
+/*!
+  \brief Count the entries a table of content lists at every level, the first being the top
+*/
+QList<int> Outline::entriesPerLevel() const {
+	QList<int> counts;
+	QList<OutlineItem *> items;
+	foreach (OutlineItem * root, d->documentOutlines)
+		items << root->children;
+	while (!items.isEmpty()) {
+		counts << items.size();
+		QList<OutlineItem *> next;
+		foreach (OutlineItem * i, items)
+			next << i->children;
+		items = next;
+	}
+	return counts;
+}
+
 void OutlinePrivate::buildHFCache(OutlineItem * i, int level) {
 	buildPrefixSum();
 	if (level >= hfCache.size()) return;
@@ -38,6 +38,8 @@ public:
 	Outline(const settings::PdfGlobal & settings);
 	~Outline();
 	void addEmptyWebPage();
+	void reserveTableOfContent(int document, const settings::PdfObject & ps, int pages);
+	QList<int> entriesPerLevel() const;
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	bool replaceWebPage(int d, const QString & name, QWebPrinter & wp, QWebFrame * f, const settings::PdfObject & ps, QVector<QPair<QWebElement, QString> > & local, QHash<QString, QWebElement> & anchors);
 	void addWebPage(const QString & name, QWebPrinter & wp, QWebFrame * frame, const settings::PdfObject & ps, QVector<QPair<QWebElement, QString> > & local, QHash<QString, QWebElement> & external);
@@ -68,8 +68,11 @@ CAPI(void) wkhtmltopdf_set_error_callback(wkhtmltopdf_converter * converter, wkh
 CAPI(void) wkhtmltopdf_set_phase_changed_callback(wkhtmltopdf_converter * converter, wkhtmltopdf_void_callback cb);
 CAPI(void) wkhtmltopdf_set_progress_changed_callback(wkhtmltopdf_converter * converter, wkhtmltopdf_int_callback cb);
 CAPI(void) wkhtmltopdf_set_finished_callback(wkhtmltopdf_converter * converter, wkhtmltopdf_int_callback cb);
-/* CAPI(void) wkhtmltopdf_begin_conversion(wkhtmltopdf_converter * converter); */
-/* CAPI(void) wkhtmltopdf_cancel(wkhtmltopdf_converter * converter); */
+CAPI(void) wkhtmltopdf_begin_conversion(wkhtmltopdf_converter * converter);
+CAPI(int) wkhtmltopdf_poll(wkhtmltopdf_converter * converter, int timeout);
+CAPI(int) wkhtmltopdf_completion_fd(wkhtmltopdf_converter * converter);
+CAPI(int) wkhtmltopdf_event_fd();
+CAPI(void) wkhtmltopdf_cancel(wkhtmltopdf_converter * converter);
 CAPI(int) wkhtmltopdf_convert(wkhtmltopdf_converter * converter);
 CAPI(void) wkhtmltopdf_add_object(
 	wkhtmltopdf_converter * converter, wkhtmltopdf_object_settings * setting, const char * data);
@@ -80,6 +83,7 @@ CAPI(const char *) wkhtmltopdf_phase_description(wkhtmltopdf_converter * convert
 CAPI(const char *) wkhtmltopdf_progress_string(wkhtmltopdf_converter * converter);
 CAPI(int) wkhtmltopdf_http_error_code(wkhtmltopdf_converter * converter);
 CAPI(long) wkhtmltopdf_get_output(wkhtmltopdf_converter * converter, const unsigned char **);
+CAPI(long) wkhtmltopdf_get_network_timings(wkhtmltopdf_converter * converter, const unsigned char **);
 
 #ifdef BUILDING_WKHTMLTOX
 #include "dllend.inc"
@@ -23,14 +23,24 @@
  * \file pdf.h
  * \brief Provides C bindings for pdf conversion
  */
+#include "eventdispatcher.hh"
 #include "pdf_c_bindings_p.hh"
+#include "renderengine.hh"
 #include "utilities.hh"
 #include <QApplication>
+#include <QEventLoop>
+#include <QTimer>
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 #include <QWebFrame>
 #endif
 
 #include <QHash>
+#include <QPointer>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "dllbegin.inc"
 /**
@@ -64,6 +74,11 @@
  * - \b load.jsdelay The mount of time in milliseconds to wait after a page has done loading until
  *      it is actually printed. E.g. "1200". We will wait this amount of time or until, javascript
  *      calls window.print().
+ * - \b load.networkIdle When not 0, instead of waiting for jsdelay, wait until there were no requests
+ *      running and no new network activity for this many milliseconds, then for fonts, animation
+ *      frames and queued tasks to settle. With WebKit only the network is waited for. E.g. "500".
+ * - \b load.networkIdleTimeout The longest time in milliseconds to wait for the network to become idle,
+ *      E.g. "30000". Use "0" to wait without limit.
  * - \b load.zoomFactor How much should we zoom in on the content? E.g. "2.2".
  * - \b load.customHeaders TODO
  * - \b load.repertCustomHeaders Should the custom headers be sent all elements loaded instead of
@@ -72,6 +87,8 @@
  * - \b load.post TODO
  * - \b load.blockLocalFileAccess Disallow local and piped files to access other local files. Must
  *      be either "true" or "false".
+ * - \b load.requestRules Path of a file with rules blocking, rewriting or stubbing out requests,
+ *      see the Request Rules section of the manual.
  * - \b load.stopSlowScript Stop slow running javascript. Must be either "true" or "false".
  * - \b load.debugJavascript Forward javascript console messages to the info callback.
  *      Must be either "true" or "false".
@@ -116,6 +133,7 @@
 
  * - \b outlineDepth The maximal depth of the outline, e.g. "4".
  * - \b dumpOutline If not set to the empty string a XML representation of the outline is dumped to this file.
+ * - \b dumpNetworkTimings If not set to the empty string the timing of every request made while loading is dumped to this file as a HAR log, see \ref wkhtmltopdf_get_network_timings.
  * - \b out The path of the output file, if "-" output is sent to stdout, if empty the output is stored in a buffer.
  * - \b documentTitle The title of the PDF document.
  * - \b useCompression Should we use loss less compression when creating the pdf file? Must be either "true" or "false".
@@ -126,6 +144,16 @@
  * - \b imageDPI The maximal DPI to use for images in the pdf document.
  * - \b imageQuality The jpeg compression factor to use when producing the pdf document, e.g. "92".
  * - \b load.cookieJar Path of file used to load and store cookies.
+ * - \b load.maxParallelPages The maximal number of objects loaded and printed at the same time,
+ *      e.g. "4". Use "0" for no limit.
+ * - \b load.shareConnections Should objects loading through the same proxy and cache share
+ *      their network connections? Must be either "true" or "false".
+ * - \b load.memoryCacheSize The megabytes of cacheable responses kept in memory for all loads,
+ *      e.g. "64". Use "0" to disable the memory cache. Only used by WebKit, WebEngine loads
+ *      through Chromium, which always keeps an HTTP cache in memory.
+ * - \b load.shareMemoryCache Should the memory cache be shared with the other conversions using
+ *      the same size? Must be either "true" or "false". Only used by WebKit, WebEngine keeps its
+ *      HTTP cache for the next conversion loaded with the same settings.
  *
  * \section pagePdfObject Pdf object settings
  * The \ref wkhtmltopdf_object_settings structure contains the following settings:
@@ -134,7 +162,8 @@
  * - \b toc.captionText The caption to use when creating a table of content.
  * - \b toc.forwardLinks Should we create links from the table of content into the actual content?
  *      Must be either "true or "false.
- * - \b toc.backLinks Should we link back from the content to this table of content.
+ * - \b toc.backLinks Should we link back from the content to this table of content?
+ *      Only supported by WebKit.
  * - \b toc.indentation The indentation used for every table of content level, e.g. "2em".
  * - \b toc.fontScale How much should we scale down the font for every toc level? E.g. "0.8"
  * - \b page The URL or path of the web page to convert, if "-" input is read from stdin.
@@ -210,6 +239,10 @@
 using namespace wkhtmltopdf;
 QApplication * a = 0;
 int usage = 0;
+#ifdef WKHTMLTOPDF_EVENT_FD
+//Installed by wkhtmltopdf_init when it creates the application
+static QPointer<PollableEventDispatcher> dispatcher;
+#endif
 
 void MyPdfConverter::debug(const QString & message) {
 	if (debug_cb && globalSettings->logLevel > settings::Info) (debug_cb)(reinterpret_cast<wkhtmltopdf_converter*>(this), message.toUtf8().constData());
@@ -236,12 +269,55 @@ void MyPdfConverter::progressChanged(int progress) {
 }
 
 void MyPdfConverter::finished(bool ok) {
+	done = true;
+#ifdef Q_OS_UNIX
+	if (completionPipe[1] != -1) {
+		char c = ok ? 1 : 0;
+		if (write(completionPipe[1], &c, 1) != 1) {}
+	}
+#endif
 	if (finished_cb) (finished_cb)(reinterpret_cast<wkhtmltopdf_converter*>(this), ok);
 }
 
+/*!
+ * Discard the outcome of an earlier conversion left in the completion pipe
+ */
+void MyPdfConverter::drainCompletion() {
+#ifdef Q_OS_UNIX
+	if (completionPipe[0] == -1) return;
+	char buff[64];
+	while (read(completionPipe[0], buff, sizeof(buff)) > 0) {}
+#endif
+}
+
+/*!
+ * Return the read end of the completion pipe, creating it on first use
+ */
+int MyPdfConverter::completionFd() {
+#ifdef Q_OS_UNIX
+	if (completionPipe[0] == -1) {
+		if (pipe(completionPipe) != 0) {
+			completionPipe[0] = completionPipe[1] = -1;
+			return -1;
+		}
+		for (int i=0; i < 2; ++i) {
+			fcntl(completionPipe[i], F_SETFL, fcntl(completionPipe[i], F_GETFL) | O_NONBLOCK);
+			fcntl(completionPipe[i], F_SETFD, FD_CLOEXEC);
+		}
+		//The conversion may already be over
+		if (done) {
+			char c = 1;
+			if (write(completionPipe[1], &c, 1) != 1) {}
+		}
+	}
+#endif
+	return completionPipe[0];
+}
+
 MyPdfConverter::MyPdfConverter(settings::PdfGlobal * gs):
 	debug_cb(0), info_cb(0), warning_cb(0), error_cb(0), phase_changed(0), progress_changed(0), finished_cb(0),
-	converter(*gs), globalSettings(gs) {
+	done(false), converter(*gs), globalSettings(gs) {
+	completionPipe[0] = completionPipe[1] = -1;
 
     connect(&converter, SIGNAL(debug(const QString &)), this, SLOT(debug(const QString &)));
     connect(&converter, SIGNAL(info(const QString &)), this, SLOT(info(const QString &)));
@@ -253,6 +329,12 @@ MyPdfConverter::MyPdfConverter(settings::PdfGlobal * gs):
 }
 
 MyPdfConverter::~MyPdfConverter() {
+#ifdef Q_OS_UNIX
+	if (completionPipe[0] != -1) {
+		close(completionPipe[0]);
+		close(completionPipe[1]);
+	}
+#endif
 	delete globalSettings;
 	for (size_t i=0; i < objectSettings.size(); ++i)
 		delete objectSettings[i];
@@ -309,6 +391,7 @@ CAPI(int) wkhtmltopdf_init(int use_graphics) {
 		setenv("QT_QPA_PLATFORM", "offscreen", 0);
 #endif
 
+		RenderEngineFactory::initialize();
 		bool ug = true;
 #if defined(Q_OS_UNIX) || defined(Q_OS_MAC)
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
@@ -319,6 +402,12 @@ CAPI(int) wkhtmltopdf_init(int use_graphics) {
 #endif
 #else
 		Q_UNUSED(use_graphics);
+#endif
+#ifdef WKHTMLTOPDF_EVENT_FD
+		if (!QAbstractEventDispatcher::instance()) {
+			dispatcher = new PollableEventDispatcher();
+			QCoreApplication::setEventDispatcher(dispatcher);
+		}
 #endif
 		a = new QApplication(aa, arg, ug);
 		a->setApplicationName(x);
@@ -572,9 +661,95 @@ CAPI(void) wkhtmltopdf_set_finished_callback(wkhtmltopdf_converter * converter,
 	reinterpret_cast<MyPdfConverter *>(converter)->finished_cb = cb;
 }
 
-//CAPI(void) wkhtmltopdf_begin_conversion(wkhtmltopdf_converter * converter) {
-//	reinterpret_cast<MyPdfConverter *>(converter)->converter.beginConversion();
-//}
+/**
+ * \brief Start converting the input objects into a pdf document, without waiting for it
+ *
+ * The conversion runs while the event loop of wkhtmltopdf is driven, by calling
+ * \ref wkhtmltopdf_poll, or by whatever event loop the application runs on the thread
+ * that called \ref wkhtmltopdf_init. Once the conversion is done the finished callback is
+ * called, \ref wkhtmltopdf_poll returns 1 and the completion fd becomes readable.
+ * Several conversions can run at the same time. To wait for the events of wkhtmltopdf
+ * without polling, see \ref wkhtmltopdf_event_fd.
+ *
+ * \param converter The converter to perform the conversion on.
+ *
+ * \sa wkhtmltopdf_poll, wkhtmltopdf_cancel, wkhtmltopdf_completion_fd, wkhtmltopdf_event_fd,
+ *     wkhtmltopdf_set_finished_callback
+ */
+CAPI(void) wkhtmltopdf_begin_conversion(wkhtmltopdf_converter * converter) {
+	MyPdfConverter * c = reinterpret_cast<MyPdfConverter *>(converter);
+	c->done = false;
+	c->drainCompletion();
+	c->converter.setQuitOnFinished(false);
+	c->converter.beginConversion();
+}
+
+/**
+ * \brief Drive the running conversions
+ *
+ * Process the pending events of wkhtmltopdf, this advances every running conversion and
+ * not just the one given.
+ *
+ * \param converter The converter to wait for
+ * \param timeout The maximal number of milliseconds to wait for the conversion to finish,
+ *        0 to only process the pending events and -1 to wait until it has finished
+ *
+ * \returns 1 if the conversion has finished and 0 otherwise
+ *
+ * \sa wkhtmltopdf_begin_conversion
+ */
+CAPI(int) wkhtmltopdf_poll(wkhtmltopdf_converter * converter, int timeout) {
+	MyPdfConverter * c = reinterpret_cast<MyPdfConverter *>(converter);
+	if (c->done) return 1;
+	if (timeout == 0) {
+		qApp->processEvents(QEventLoop::AllEvents);
+		return c->done;
+	}
+	QEventLoop loop;
+	QObject::connect(&c->converter, SIGNAL(finished(bool)), &loop, SLOT(quit()));
+	if (timeout > 0) QTimer::singleShot(timeout, &loop, SLOT(quit()));
+	loop.exec();
+	return c->done;
+}
+
+/**
+ * \brief Get a file descriptor that becomes readable once the conversion has finished
+ *
+ * This allows waiting for conversions with select, poll or epoll. Note that the events
+ * of wkhtmltopdf must still be processed for the conversion to advance, wait for
+ * \ref wkhtmltopdf_event_fd as well and call \ref wkhtmltopdf_poll with a timeout of 0
+ * when it is readable. The descriptor is owned by the converter and is closed when it
+ * is destroyed. A single byte is written to it once the conversion is done, 1 if it
+ * succeeded and 0 otherwise. The byte is discarded when the next conversion begins.
+ *
+ * \param converter The converter to get the descriptor for
+ *
+ * \returns The file descriptor, or -1 if it is not supported on this platform
+ */
+CAPI(int) wkhtmltopdf_completion_fd(wkhtmltopdf_converter * converter) {
+	return reinterpret_cast<MyPdfConverter *>(converter)->completionFd();
+}
+
+/**
+ * \brief Get a file descriptor that is readable whenever wkhtmltopdf has events to process
+ *
+ * An application can wait for this descriptor together with its own, using select, poll
+ * or epoll, and call \ref wkhtmltopdf_poll with a timeout of 0 when it becomes readable.
+ * This advances every running conversion without busy waiting. The descriptor stays
+ * readable until the events are processed, and is closed by \ref wkhtmltopdf_deinit.
+ *
+ * It is only available on linux, when \ref wkhtmltopdf_init created the application.
+ *
+ * \returns The file descriptor, or -1 if it is not available
+ *
+ * \sa wkhtmltopdf_begin_conversion, wkhtmltopdf_completion_fd
+ */
+CAPI(int) wkhtmltopdf_event_fd() {
+#ifdef WKHTMLTOPDF_EVENT_FD
+	if (dispatcher) return dispatcher->fd();
+#endif
+	return -1;
+}
 
 /**
  * \brief Convert the input objects into a pdf document
@@ -594,9 +769,18 @@ CAPI(int) wkhtmltopdf_convert(wkhtmltopdf_converter * converter) {
 	return reinterpret_cast<MyPdfConverter *>(converter)->converter.convert();
 }
 
-//CAPI(void) wkhtmltopdf_cancel(wkhtmltopdf_converter * converter) {
-//	reinterpret_cast<MyPdfConverter *>(converter)->converter.cancel();
-//}
+/**
+ * \brief Cancel a running conversion
+ *
+ * The conversion fails right away, and the finished callback is called.
+ *
+ * \param converter The converter to cancel the conversion of
+ *
+ * \sa wkhtmltopdf_begin_conversion
+ */
+CAPI(void) wkhtmltopdf_cancel(wkhtmltopdf_converter * converter) {
+	reinterpret_cast<MyPdfConverter *>(converter)->converter.cancel();
+}
 
 /**
  * \brief add an object (web page to convert)
@@ -717,6 +901,28 @@ CAPI(long) wkhtmltopdf_get_output(wkhtmltopdf_converter * converter, const unsig
 	return out.size();
 }
 
+/**
+ * \brief Get the timing of every request made while loading the input objects
+ *
+ * The timings are returned as a HAR log in JSON. For every request the time spent
+ * resolving the name, connecting, waiting for the first byte and receiving the
+ * response is given in milliseconds, along with the number of bytes received.
+ * Phases that could not be measured are -1. WebKit cannot tell when a name was
+ * resolved or a connection made, so with it the dns, connect and ssl phases are
+ * always -1. The data stays valid until this function is called again or the
+ * converter is destroyed.
+ *
+ * \param converter The converter to query
+ * \param d A pointer to a pointer that will be made to point to the HAR log
+ * \returns The length of the HAR log
+ */
+CAPI(long) wkhtmltopdf_get_network_timings(wkhtmltopdf_converter * converter, const unsigned char ** d) {
+	MyPdfConverter * c = reinterpret_cast<MyPdfConverter *>(converter);
+	c->networkTimings = NetworkTiming::toHar(c->converter.networkTimings());
+	*d = (const unsigned char*)c->networkTimings.constData();
+	return c->networkTimings.size();
+}
+
 //  LocalWords:  eval progn stroustrup innamespace sts sw noet wkhtmltopdf DLL
 //  LocalWords:  ifdef WKHTMLTOX UNDEF undef endif pdf dllbegin namespace const
 //  LocalWords:  QString cb bool ok globalSettings phaseChanged progressChanged
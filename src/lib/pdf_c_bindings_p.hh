@@ -40,14 +40,23 @@ public:
 	wkhtmltopdf_int_callback progress_changed;
 	wkhtmltopdf_int_callback finished_cb;
 
+	//Set once an asynchronous conversion has finished
+	bool done;
+	//Pipe made readable once the conversion has finished, -1 until requested
+	int completionPipe[2];
+
 	wkhtmltopdf::PdfConverter converter;
 
 	wkhtmltopdf::settings::PdfGlobal * globalSettings;
 	std::vector<wkhtmltopdf::settings::PdfObject *> objectSettings;
   QHash<QString, QByteArray> utf8StringCache;
+	//HAR log handed out by wkhtmltopdf_get_network_timings
+	QByteArray networkTimings;
 
 	MyPdfConverter(wkhtmltopdf::settings::PdfGlobal * gs);
 	~MyPdfConverter();
+	int completionFd();
+	void drainCompletion();
 public slots:
     void debug(const QString & message);
     void info(const QString & message);
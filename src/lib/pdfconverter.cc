@@ -21,11 +21,14 @@
 
 #include "pdfconverter_p.hh"
 #include <QAuthenticator>
+#include <QBuffer>
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
 #include <QPair>
 #include <QPrintEngine>
+#include <QTextStream>
 #include <QTimer>
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 #include <QWebFrame>
@@ -34,6 +37,7 @@
 #endif
 #include <QXmlQuery>
 #include <algorithm>
+#include <cmath>
 #include <qapplication.h>
 #include <qfileinfo.h>
 #ifdef Q_OS_WIN32
@@ -41,83 +45,721 @@
 #include <io.h>
 #endif
 
-#ifndef WKHTMLTOPDF_USE_WEBKIT
-
 #include "dllbegin.inc"
 using namespace wkhtmltopdf;
 using namespace wkhtmltopdf::settings;
 
-namespace wkhtmltopdf {
+#define STRINGIZE_(x) #x
+#define STRINGIZE(x) STRINGIZE_(x)
+
+const qreal PdfConverter::millimeterToPointMultiplier = 3.779527559;
+
+struct DLL_LOCAL CompiledStyleSheet {
+	QDateTime modified;
+	QXmlQuery query;
+};
+
+typedef QHash<QString, CompiledStyleSheet> StyleSheetCache;
+static StyleSheetCache * styleSheetCache = 0;
+
+/*!
+  \brief Drop the compiled style sheets while the application still exists
+*/
+static void clearStyleSheetCache() {
+	delete styleSheetCache;
+	styleSheetCache = 0;
+}
+
+/*!
+  \brief Get the compiled style sheet transforming the outline into a table of content
+
+  Style sheets are kept for the lifetime of the application, so converting many
+  documents only compiles each of them once. A style sheet file is compiled
+  again when its modification time changes.
+  \param ps The settings of the table of content
+  \param focus The outline to transform, bound to the query before it is returned
+  \returns The style sheet, or 0 if it could not be read or compiled
+*/
+static QXmlQuery * compiledTocStyleSheet(const settings::PdfObject & ps, QIODevice * focus) {
+	if (!styleSheetCache) {
+		styleSheetCache = new StyleSheetCache();
+		qAddPostRoutine(clearStyleSheetCache);
+	}
+	StyleSheetCache & cache = *styleSheetCache;
+
+	QByteArray style;
+	QString key;
+	QDateTime modified;
+	QUrl url;
+	if (ps.tocXsl.isEmpty()) {
+		//The default style sheet depends on the toc settings
+		settings::TableOfContent toc = ps.toc;
+		{
+			QTextStream stream(&style);
+			stream.setCodec("UTF-8");
+			dumpDefaultTOCStyleSheet(stream, toc);
+		}
+		key = "default:" + QCryptographicHash::hash(style, QCryptographicHash::Sha1).toHex();
+	} else {
+		QFileInfo info(ps.tocXsl);
+		key = info.absoluteFilePath();
+		modified = info.lastModified();
+		url = QUrl::fromLocalFile(key);
+	}
+
+	StyleSheetCache::iterator i = cache.find(key);
+	if (i != cache.end() && i->modified == modified) {
+		i->query.setFocus(focus);
+		return &i->query;
+	}
+
+	if (!ps.tocXsl.isEmpty()) {
+		QFile file(ps.tocXsl);
+		if (!file.open(QIODevice::ReadOnly)) return 0;
+		style = file.readAll();
+	}
+
+	QBuffer buffer(&style);
+	buffer.open(QIODevice::ReadOnly);
+	CompiledStyleSheet & compiled = cache[key];
+	compiled.modified = modified;
+	compiled.query = QXmlQuery(QXmlQuery::XSLT20);
+	//The focus of an XSLT query has to be set before the style sheet
+	compiled.query.setFocus(focus);
+	compiled.query.setQuery(&buffer, url);
+	if (!compiled.query.isValid()) {
+		cache.remove(key);
+		return 0;
+	}
+	return &compiled.query;
+}
+
+#ifndef WKHTMLTOPDF_USE_WEBKIT
+
+/*!
+  \file pageconverter_p.hh
+  \brief Defines the PdfConverterPrivate class
+*/
+
+PdfConverterPrivate::PdfConverterPrivate(PdfGlobal & s, PdfConverter & o) :
+	settings(s), pageLoader(s.load, settings.dpi, true), tocLoader(s.load, settings.dpi),
+	out(o), printing(0), printed(0), toPrint(0), nextObject(0), nextMerge(0), pageCount(0),
+	tocs(0), tocsDone(0), tocRenderings(0), merger(0) {
+
+	phaseDescriptions.push_back("Loading pages");
+	phaseDescriptions.push_back("Printing pages");
+	phaseDescriptions.push_back("Done");
+
+	connect(&pageLoader, SIGNAL(loadProgress(int)), this, SLOT(loadProgress(int)));
+	connect(&pageLoader, SIGNAL(loadFinished(bool)), this, SLOT(pagesLoaded(bool)));
+	connect(&pageLoader, SIGNAL(error(QString)), this, SLOT(forwardError(QString)));
+	connect(&pageLoader, SIGNAL(warning(QString)), this, SLOT(forwardWarning(QString)));
+	connect(&pageLoader, SIGNAL(info(QString)), this, SLOT(forwardInfo(QString)));
+	connect(&pageLoader, SIGNAL(debug(QString)), this, SLOT(forwardDebug(QString)));
+
+	tocLoader.shareMemoryCache(pageLoader);
+	connect(&tocLoader, SIGNAL(loadFinished(bool)), this, SLOT(tocLoaded(bool)));
+	connect(&tocLoader, SIGNAL(error(QString)), this, SLOT(forwardError(QString)));
+	connect(&tocLoader, SIGNAL(warning(QString)), this, SLOT(forwardWarning(QString)));
+	connect(&tocLoader, SIGNAL(info(QString)), this, SLOT(forwardInfo(QString)));
+	connect(&tocLoader, SIGNAL(debug(QString)), this, SLOT(forwardDebug(QString)));
+
+	if ( ! settings.viewportSize.isEmpty())
+	{
+		QStringList viewportSizeList = settings.viewportSize.split("x");
+		int width = viewportSizeList.first().toInt();
+		int height = viewportSizeList.last().toInt();
+		viewportSize = QSize(width,height);
+	}
+}
+
+PdfConverterPrivate::~PdfConverterPrivate() {
+	clearResources();
+}
 
-PdfConverterPrivate::PdfConverterPrivate(settings::PdfGlobal & s, PdfConverter & o):
-        settings(s),
-        outputData(),
-        out(o) {
-        currentPhase = 0;
-        error = false;
-        errorCode = 0;
-        conversionDone = false;
-        phaseDescriptions << "Page loading" << "PDF rendering";
+/*!
+  \brief Get the prefix of the names given to the headings of an object
+*/
+static QString headingPrefix(int d) {
+	return QString("__wkhtmltopdf_%1_").arg(d);
 }
 
+/*!
+ * Start loading every object, each one gets its own render page
+ */
 void PdfConverterPrivate::beginConvert() {
-        error = true;
-        conversionDone = true;
-        emit outer().error(QStringLiteral("PDF conversion requires the legacy Qt WebKit backend, which is no longer available in this WebEngine-only build."));
-        emit outer().finished(false);
-        qApp->exit(0);
+	error=false;
+	progressString = "0%";
+	currentPhase=0;
+	errorCode=0;
+	pageCount=0;
+
+	for (QList<PageObject>::iterator i=objects.begin(); i != objects.end(); ++i) {
+		PageObject & o=*i;
+		settings::PdfObject & s = o.settings;
+
+		if (s.isTableOfContent) {
+			//Tables of content are rendered from the outline once every other object is printed
+			if (s.toc.backLinks)
+				emit out.warning("Links back to the table of contents are not supported by the WebEngine backend, they are skipped.");
+			continue;
+		}
+		if (!s.header.htmlUrl.isEmpty() || !s.footer.htmlUrl.isEmpty())
+			emit out.warning("Html headers and footers are not supported by the WebEngine backend, they are skipped.");
+
+		o.loaderObject = pageLoader.addResource(s.page, s.load, &o.data);
+		if (!o.loaderObject) {
+			fail();
+			return;
+		}
+		o.page = &o.loaderObject->page;
+		o.page->applySettings(s.web);
+		if (viewportSize.isValid() && !viewportSize.isEmpty())
+			o.page->setViewportSize(viewportSize);
+	}
+
+	emit out.phaseChanged();
+	loadProgress(0);
+
+	pageLoader.load();
 }
 
-void PdfConverterPrivate::clearResources() {}
+/*!
+ * Build the page layout used when printing every object
+ */
+QPageLayout PdfConverterPrivate::pageLayout() const {
+	QPrinter printer(settings.resolution);
+	printer.setOutputFormat(QPrinter::PdfFormat);
+	printer.setResolution(settings.dpi);
+	//Without html headers and footers an automatic margin is a plain one
+	printer.setPageMargins(settings.margin.left.first,
+						   settings.margin.top.first < 0 ? 10 : settings.margin.top.first,
+						   settings.margin.right.first,
+						   settings.margin.bottom.first < 0 ? 10 : settings.margin.bottom.first,
+						   settings.margin.left.second);
+	if ((settings.size.height.first != -1) && (settings.size.width.first != -1)) {
+		printer.setPaperSize(QSizeF(settings.size.width.first,settings.size.height.first), settings.size.height.second);
+	} else {
+		printer.setPaperSize(settings.size.pageSize);
+	}
+	printer.setOrientation(settings.orientation);
+	return printer.pageLayout();
+}
 
-Converter & PdfConverterPrivate::outer() {
-        return out;
+/*!
+ * Every object has loaded, print them all into memory
+ */
+void PdfConverterPrivate::pagesLoaded(bool ok) {
+	if (errorCode == 0) errorCode = pageLoader.httpErrorCode();
+	if (!ok) {
+		fail();
+		return;
+	}
+
+	//We currently only support margins with the same unit
+	if (settings.margin.left.second != settings.margin.right.second ||
+		settings.margin.left.second != settings.margin.top.second ||
+		settings.margin.left.second != settings.margin.bottom.second) {
+		emit out.error("Currently all margin units must be the same!");
+		fail();
+		return;
+	}
+
+	currentPhase = 1;
+	emit out.phaseChanged();
+	progressString = "0%";
+	emit out.progressChanged(0);
+
+	layout = pageLayout();
+	printing = 0;
+	printed = 0;
+	toPrint = 0;
+	nextObject = 0;
+	tocs = 0;
+	tocRenderings = 0;
+	for (int d=0; d < objects.size(); ++d) {
+		if (!printable(objects[d])) continue;
+		++toPrint;
+		if (objects[d].settings.isTableOfContent) ++tocs;
+	}
+	if (toPrint == 0) {
+		emit out.error("No pages to print");
+		fail();
+		return;
+	}
+	nextMerge = 0;
+	if (!openOutput()) {
+		fail();
+		return;
+	}
+	if (tocs == toPrint) loadTocs();
+	else printNext();
 }
 
-PdfConverter::PdfConverter(settings::PdfGlobal & globalSettings):
-        Converter(),
-        d(new PdfConverterPrivate(globalSettings, *this)) {}
+/*!
+ * Start printing objects until settings.load.maxParallelPages are printing.
+ * Every object is stored at its own index, so the completion order does not
+ * matter for the output
+ */
+void PdfConverterPrivate::printNext() {
+	int max = settings.load.maxParallelPages;
+	while (nextObject < objects.size() && (max <= 0 || printing < max)) {
+		int d = nextObject++;
+		if (!printable(objects[d]) || objects[d].settings.isTableOfContent) continue;
+		++printing;
+		printWithHeadings(d);
+	}
+}
 
-PdfConverter::~PdfConverter() {
-        delete d;
+/*!
+ * Find the headings of an object when they are listed, then print it
+ */
+void PdfConverterPrivate::printWithHeadings(int d) {
+	if (!listsHeadings(objects[d])) {
+		printObject(d);
+		return;
+	}
+	QPointer<PdfConverterPrivate> self(this);
+	objects[d].page->headings(headingPrefix(d), [self, d](const QList<HeadingInfo> & headings) {
+		if (!self || self->conversionDone || d >= self->objects.size()) return;
+		self->objects[d].headings = headings;
+		self->printObject(d);
+	});
 }
 
-int PdfConverter::pageCount() {
-        return 0;
+/*!
+ * Print a single object and append what can be appended to the output
+ */
+void PdfConverterPrivate::printObject(int d) {
+	//The converter may be gone by the time the page is printed
+	QPointer<PdfConverterPrivate> self(this);
+	objects[d].page->printToPdf(layout, [self, d](const QByteArray & pdf) {
+		if (self) self->objectPrinted(d, pdf);
+	});
 }
 
-void PdfConverter::addResource(const settings::PdfObject &, const QString *) {
-        emit error(QStringLiteral("PDF conversion is unavailable without Qt WebKit support."));
+/*!
+ * An object has been printed, append it and start printing the next
+ */
+void PdfConverterPrivate::objectPrinted(int d, const QByteArray & pdf) {
+	if (conversionDone || d >= objects.size()) return;
+	PageObject & obj = objects[d];
+	obj.pdf = pdf;
+	if (pdf.isEmpty()) {
+		emit out.error("Printing the page failed");
+		fail();
+		return;
+	}
+	//The headings are found through the named destinations the renderer
+	//wrote where it printed them
+	obj.destinations.clear();
+	if ((needsOutline() || inOutline(obj)) && !PdfMerger::destinations(pdf, obj.pageCount, obj.destinations)) {
+		emit out.error("Unable to parse the printed page");
+		fail();
+		return;
+	}
+	if (obj.settings.isTableOfContent) {
+		if (++tocsDone == tocs) tocsPrinted();
+		return;
+	}
+	--printing;
+	++printed;
+	progressString = QString("Object %1 of %2").arg(printed).arg(toPrint);
+	emit out.progressChanged(printed * 100 / toPrint);
+	if (!mergePrinted()) {
+		fail();
+		return;
+	}
+	if (printed == toPrint) printDocument();
+	else if (printed + tocs == toPrint) loadTocs();
+	else printNext();
 }
 
-const settings::PdfGlobal & PdfConverter::globalSettings() const {
-        return d->settings;
+/*!
+ * Is the object printed, tables of content are rendered from the outline
+ */
+bool PdfConverterPrivate::printable(const PageObject & obj) const {
+	return obj.settings.isTableOfContent || (obj.loaderObject && !obj.loaderObject->skip);
 }
 
-const QByteArray & PdfConverter::output() {
-        return d->outputData;
+/*!
+ * Should the object and its headings be listed in the outline
+ */
+bool PdfConverterPrivate::inOutline(const PageObject & obj) const {
+	return settings.outline && settings.outlineDepth > 0 && obj.settings.includeInOutline;
 }
 
-ConverterPrivate & PdfConverter::priv() {
-        return *d;
+/*!
+ * Is the outline of the objects needed, for tables of content or to dump it
+ */
+bool PdfConverterPrivate::needsOutline() const {
+	return tocs > 0 || !settings.dumpOutline.isEmpty();
 }
 
-#endif // WKHTMLTOPDF_USE_WEBKIT
+/*!
+ * Should the headings of the object be found before printing it
+ */
+bool PdfConverterPrivate::listsHeadings(const PageObject & obj) const {
+	return obj.settings.includeInOutline && (needsOutline() || inOutline(obj));
+}
 
+/*!
+ * Write an item of the outline xml, the closing tag is left to the caller
+ */
+static QString outlineItem(int depth, const QString & title, int page, const QString & link) {
+	return QString(depth * 2, ' ') + QString("<item title=\"%1\" page=\"%2\" link=\"%3\">\n")
+		.arg(title.toHtmlEscaped(), QString::number(page), link.toHtmlEscaped());
 }
 
-#include "dllend.inc"
+/*!
+ * Dump the outline of the printed objects in the format of Outline::dump
+ *
+ * Every object is an item of its own, its headings are nested below it by
+ * their level. Headings that were not printed have no destination and are
+ * left out.
+ * \param entries Receives the number of headings at every level, the first being the top
+ */
+QByteArray PdfConverterPrivate::outlineXml(QList<int> & entries) const {
+	entries.clear();
+	QString xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<outline xmlns=\"http://wkhtmltopdf.org/outline\">\n";
+	int first = settings.pageOffset + 1;
+	for (int d=0; d < objects.size(); ++d) {
+		const PageObject & obj = objects[d];
+		if (!printable(obj)) continue;
+		QString title = obj.settings.toc.captionText;
+		if (!obj.settings.isTableOfContent) {
+			title = obj.page->title();
+			if (title.isEmpty()) title = obj.page->url().toString();
+		}
+		xml += outlineItem(1, title, first, QString());
+
+		//Levels of the headings the next one may be nested in
+		QList<int> levels;
+		foreach (const HeadingInfo & h, obj.headings) {
+			QHash<QByteArray, PdfMerger::Destination>::const_iterator i = obj.destinations.constFind(h.anchor.toUtf8());
+			if (i == obj.destinations.constEnd()) continue;
+			while (!levels.isEmpty() && levels.last() >= h.level) {
+				xml += QString(levels.size() * 2 + 2, ' ') + "</item>\n";
+				levels.removeLast();
+			}
+			levels << h.level;
+			if (entries.size() < levels.size()) entries << 0;
+			++entries[levels.size() - 1];
+			xml += outlineItem(levels.size() + 1, h.text, first + i->page, "#" + h.anchor);
+		}
+		for (; !levels.isEmpty(); levels.removeLast())
+			xml += QString(levels.size() * 2 + 2, ' ') + "</item>\n";
+		xml += "  </item>\n";
+		if (obj.settings.pagesCount) first += obj.pageCount;
+	}
+	xml += "</outline>\n";
+	return xml.toUtf8();
+}
 
-#else
+/*!
+ * Guess the pages a table of content takes
+ *
+ * Only the layout of the default style sheet can be guessed, other tables
+ * of content start out with a single page.
+ * \param entries The number of entries at every level
+ */
+int PdfConverterPrivate::guessTocPages(const settings::PdfObject & ps, const QList<int> & entries) const {
+	if (!ps.tocXsl.isEmpty()) return 1;
+	//Sizes used by the default style sheet, in css pixels
+	qreal pageHeight = layout.paintRect(QPageLayout::Inch).height() * 96;
+	qreal height = 16 + 20 * 1.15 + 2 * 0.67 * 20;
+	qreal fontSize = 20;
+	for (int l=0; l < entries.size(); ++l) {
+		height += entries[l] * (fontSize * 1.15 + (ps.toc.useDottedLines ? 1 : 0));
+		fontSize *= ps.toc.fontScale;
+	}
+	return qMax(1, int(std::ceil(height / pageHeight)));
+}
 
-#include "dllbegin.inc"
-using namespace wkhtmltopdf;
-using namespace wkhtmltopdf::settings;
+/*!
+ * Transform the outline into the html of a table of content
+ */
+bool PdfConverterPrivate::tocHtml(const settings::PdfObject & ps, const QByteArray & xml, QByteArray & html) {
+	QBuffer xmlBuffer;
+	xmlBuffer.setData(xml);
+	xmlBuffer.open(QIODevice::ReadOnly);
+	QXmlQuery * query = compiledTocStyleSheet(ps, &xmlBuffer);
+	if (!query) {
+		emit out.error("Could not read the TOC XSL");
+		return false;
+	}
 
-#define STRINGIZE_(x) #x
-#define STRINGIZE(x) STRINGIZE_(x)
+	QBuffer htmlBuffer(&html);
+	htmlBuffer.open(QIODevice::WriteOnly);
+	if (!query->evaluateTo(&htmlBuffer) || html.isEmpty()) {
+		emit out.error("Could not apply the TOC XSL");
+		return false;
+	}
+	return true;
+}
 
-const qreal PdfConverter::millimeterToPointMultiplier = 3.779527559;
+/*!
+ * Render the tables of content from the outline of the printed objects
+ *
+ * The pages the tables take are guessed before the first rendering, so the
+ * page numbers they list usually hold and they are rendered once. The
+ * renderer only links to names the document holds, so every table gets
+ * hidden targets named like the headings it links to. The links are resolved
+ * when the documents are merged.
+ */
+void PdfConverterPrivate::loadTocs() {
+	if (tocRenderings == 0) {
+		for (int d=0; d < objects.size(); ++d) {
+			PageObject & obj = objects[d];
+			const settings::PdfObject & ps = obj.settings;
+			//The caption of the default style sheet is the first heading of the table
+			if (!ps.isTableOfContent || !listsHeadings(obj) || !ps.tocXsl.isEmpty() ||
+				ps.toc.captionText.trimmed().isEmpty()) continue;
+			HeadingInfo h;
+			h.level = 1;
+			h.text = ps.toc.captionText.simplified();
+			h.anchor = headingPrefix(d) + "0";
+			obj.headings << h;
+			PdfMerger::Destination dest;
+			dest.page = 0;
+			dest.top = -1;
+			obj.destinations[h.anchor.toUtf8()] = dest;
+		}
+		QList<int> entries;
+		outlineXml(entries);
+		for (int d=0; d < objects.size(); ++d)
+			if (objects[d].settings.isTableOfContent)
+				objects[d].pageCount = guessTocPages(objects[d].settings, entries);
+	}
+
+	++tocRenderings;
+	QList<int> entries;
+	tocOutline = outlineXml(entries);
+	tocLoader.clearResources();
+	for (int d=0; d < objects.size(); ++d) {
+		PageObject & obj = objects[d];
+		if (!obj.settings.isTableOfContent) continue;
+		obj.loaderObject = 0;
+		obj.page = 0;
+
+		QByteArray html;
+		if (!tocHtml(obj.settings, tocOutline, html)) {
+			fail();
+			return;
+		}
+		QByteArray targets;
+		for (int e=0; e < objects.size(); ++e) {
+			if (e == d) continue;
+			foreach (const HeadingInfo & h, objects[e].headings)
+				targets += "<a name=\"" + h.anchor.toUtf8() + "\"></a>";
+		}
+		if (!targets.isEmpty()) {
+			targets = "<div style=\"display:none\">" + targets + "</div>";
+			int body = html.lastIndexOf("</body>");
+			if (body == -1) html += targets;
+			else html.insert(body, targets);
+		}
+
+		QString data = QString::fromUtf8(html);
+		obj.loaderObject = tocLoader.addResource(QString(), obj.settings.load, &data);
+		if (!obj.loaderObject) {
+			fail();
+			return;
+		}
+		obj.page = &obj.loaderObject->page;
+		obj.page->applySettings(obj.settings.web);
+		if (viewportSize.isValid() && !viewportSize.isEmpty())
+			obj.page->setViewportSize(viewportSize);
+	}
+	tocsDone = 0;
+	tocLoader.load();
+}
+
+/*!
+ * The tables of content have loaded, print them
+ */
+void PdfConverterPrivate::tocLoaded(bool ok) {
+	if (errorCode == 0) errorCode = tocLoader.httpErrorCode();
+	if (!ok) {
+		fail();
+		return;
+	}
+	for (int d=0; d < objects.size(); ++d) {
+		if (!objects[d].settings.isTableOfContent) continue;
+		objects[d].pdf.clear();
+		printWithHeadings(d);
+	}
+}
+
+/*!
+ * Every table of content is printed, render them again if the page numbers
+ * they list changed
+ */
+void PdfConverterPrivate::tocsPrinted() {
+	QList<int> entries;
+	//A table of content that keeps changing its own length settles for the last rendering
+	if (outlineXml(entries) != tocOutline && tocRenderings < 5) {
+		loadTocs();
+		return;
+	}
+	printed += tocs;
+	progressString = QString("Object %1 of %2").arg(printed).arg(toPrint);
+	emit out.progressChanged(printed * 100 / toPrint);
+	if (!mergePrinted()) {
+		fail();
+		return;
+	}
+	printDocument();
+}
+
+/*!
+ * Open the destination the merged document is streamed to
+ */
+bool PdfConverterPrivate::openOutput() {
+	QIODevice * device = &outFile;
+	if (settings.out == "-") {
+#ifdef Q_OS_WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		if (!outFile.open(stdout, QIODevice::WriteOnly)) {
+			emit out.error("Could not write to stdout");
+			return false;
+		}
+	} else if (settings.out.isEmpty()) {
+		outputData.clear();
+		outBuffer.setBuffer(&outputData);
+		outBuffer.open(QIODevice::WriteOnly);
+		device = &outBuffer;
+	} else {
+		outFile.setFileName(settings.out);
+		if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+			emit out.error("Unable to write to destination");
+			return false;
+		}
+	}
+	merger = new PdfMerger(device);
+	merger->setTitle(settings.documentTitle);
+	merger->setPageOffset(settings.pageOffset);
+	merger->setCopies(settings.copies, settings.collate);
+	return true;
+}
+
+/*!
+ * Append the printed objects to the output in order, as soon as every
+ * object before them has been appended. The printed bytes are dropped
+ * right after they are written. The objects after a table of content
+ * wait until it is printed last.
+ */
+bool PdfConverterPrivate::mergePrinted() {
+	for (; nextMerge < objects.size(); ++nextMerge) {
+		PageObject & obj = objects[nextMerge];
+		if (!printable(obj)) continue;
+		if (obj.pdf.isEmpty()) break;
+		int first = merger->pageCount();
+		if (!merger->append(obj.pdf)) {
+			emit out.error(merger->errorString());
+			return false;
+		}
+		obj.pdf.clear();
+		if (!inOutline(obj)) continue;
+
+		QString title = obj.page->title();
+		merger->addOutlineEntry(title.isEmpty() ? obj.page->url().toString() : title, 0, first);
+		foreach (const HeadingInfo & h, obj.headings) {
+			QHash<QByteArray, PdfMerger::Destination>::const_iterator i = obj.destinations.constFind(h.anchor.toUtf8());
+			//Headings that were not printed have no destination
+			if (h.level > settings.outlineDepth || i == obj.destinations.constEnd()) continue;
+			merger->addOutlineEntry(h.text, h.level, first + i->page, i->top);
+		}
+	}
+	return true;
+}
+
+/*!
+ * Every object has been appended, complete the document
+ */
+void PdfConverterPrivate::printDocument() {
+	if (!merger->finish()) {
+		emit out.error(merger->errorString());
+		fail();
+		return;
+	}
+	//As with WebKit the pages of a single copy are counted
+	pageCount = merger->pageCount();
+	if (!settings.dumpOutline.isEmpty()) {
+		QList<int> entries;
+		QFile file(settings.dumpOutline);
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(outlineXml(entries)) == -1)
+			emit out.warning("Unable to write the outline to " + settings.dumpOutline);
+	}
+	dumpNetworkTimings();
+
+	clearResources();
+	currentPhase = 2;
+	emit out.phaseChanged();
+	conversionDone = true;
+	emit out.finished(true);
+
+	if (quitOnFinished) qApp->exit(0); // quit qt's event handling
+}
+
+QList<NetworkTiming> PdfConverterPrivate::networkTimings() const {
+	return pageLoader.networkTimings();
+}
+
+void PdfConverterPrivate::clearResources() {
+	objects.clear();
+	pageLoader.clearResources();
+	tocLoader.clearResources();
+	if (merger) {
+		PdfMerger * tmp = merger;
+		merger = 0;
+		delete tmp;
+	}
+	outFile.close();
+	outBuffer.close();
+}
+
+Converter & PdfConverterPrivate::outer() {
+	return out;
+}
+
+PdfConverter::PdfConverter(settings::PdfGlobal & settings):
+	d(new PdfConverterPrivate(settings, *this)) {
+}
+
+PdfConverter::~PdfConverter() {
+	PdfConverterPrivate *tmp = d;
+	d = 0;
+	tmp->deleteLater();
+}
+
+/*!
+  \brief Returns the number of pages in the last converted document
+*/
+int PdfConverter::pageCount() {
+	return d->pageCount;
+}
+
+void PdfConverter::addResource(const settings::PdfObject & page, const QString * data) {
+	d->objects.push_back( PageObject(page, data) );
+	d->objects.back().number = d->objects.size()-1;
+}
+
+const settings::PdfGlobal & PdfConverter::globalSettings() const {
+	return d->settings;
+}
+
+const QByteArray & PdfConverter::output() {
+	return d->outputData;
+}
+
+ConverterPrivate & PdfConverter::priv() {
+	return *d;
+}
+
+#else
 
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 DLL_LOCAL QMap<QWebPage *, PageObject *> PageObject::webPageToObject;
@@ -133,6 +775,7 @@ struct DLL_LOCAL StreamDumper {
 	}
 };
 
+
 /*!
   \file pageconverter.hh
   \brief Defines the PdfConverter class
@@ -178,6 +821,12 @@ PdfConverterPrivate::PdfConverterPrivate(PdfGlobal & s, PdfConverter & o) :
 	connect(&pageLoader, SIGNAL(debug(QString)), this, SLOT(forwardDebug(QString)));
 
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+	//All loads of the conversion keep their responses in the same memory cache
+	measuringHFLoader.shareMemoryCache(pageLoader);
+	hfLoader.shareMemoryCache(pageLoader);
+	tocLoader1.shareMemoryCache(pageLoader);
+	tocLoader2.shareMemoryCache(pageLoader);
+
     connect(&measuringHFLoader, SIGNAL(loadProgress(int)), this, SLOT(loadProgress(int)));
     connect(&measuringHFLoader, SIGNAL(loadFinished(bool)), this, SLOT(measuringHeadersLoaded(bool)));
     connect(&measuringHFLoader, SIGNAL(error(QString)), this, SLOT(forwardError(QString)));
@@ -404,6 +1053,45 @@ void PdfConverterPrivate::preprocessPage(PageObject & obj) {
 		outline->addEmptyWebPage();
 	painter->restore();
 }
+
+/*!
+ * Reserve the pages the tables of content are expected to take
+ *
+ * A table of content is rendered again until its page count and outline
+ * stop changing the page numbers it lists. Guessing both up front makes the
+ * first rendering the last one in the common case. Only the layout of the
+ * default style sheet can be guessed, other tables of content start out
+ * with a single page.
+ */
+void PdfConverterPrivate::reserveTocPages() {
+	QList<int> entries = outline->entriesPerLevel();
+	if (entries.isEmpty()) entries << 0;
+	//Every table of content lists its own caption
+	for (int d=0; d < objects.size(); ++d)
+		if (objects[d].settings.isTableOfContent && objects[d].settings.tocXsl.isEmpty() &&
+			!objects[d].settings.toc.captionText.trimmed().isEmpty()) ++entries[0];
+
+	for (int d=0; d < objects.size(); ++d) {
+		PageObject & obj = objects[d];
+		const settings::PdfObject & ps = obj.settings;
+		if (!ps.isTableOfContent || !ps.tocXsl.isEmpty()) continue;
+
+		//Sizes used by the default style sheet, in css pixels
+		qreal pageHeight = printer->pageRect(QPrinter::Inch).height() * 96 / ps.load.zoomFactor;
+		qreal height = 16 + 20 * 1.15 + 2 * 0.67 * 20;
+		qreal fontSize = 20;
+		for (int l=0; l < entries.size(); ++l) {
+			height += entries[l] * (fontSize * 1.15 + (ps.toc.useDottedLines ? 1 : 0));
+			fontSize *= ps.toc.fontScale;
+		}
+		int pages = qMax(1, int(std::ceil(height / pageHeight)));
+
+		outline->reserveTableOfContent(obj.number, ps, pages);
+		pageCount -= obj.pageCount;
+		obj.pageCount = ps.pagesCount ? pages : 0;
+		pageCount += obj.pageCount;
+	}
+}
 #endif
 
 /*!
@@ -518,6 +1206,7 @@ void PdfConverterPrivate::pagesLoaded(bool ok) {
 	currentObject = 0;
 	for (int d=0; d < objects.size(); ++d)
 		preprocessPage(objects[d]);
+	reserveTocPages();
 	actualPages = pageCount * settings.copies;
 
 	loadTocs();
@@ -572,42 +1261,35 @@ void PdfConverterPrivate::loadTocs() {
 		if (!ps.isTableOfContent) continue;
 		obj.clear();
 
-		QString style = ps.tocXsl;
-		if (style.isEmpty()) {
-			style = obj.tocFile.create(".xsl");
-			StreamDumper styleDump(style);
-			dumpDefaultTOCStyleSheet(styleDump.stream, ps.toc);
+		//The outline and the resulting html are kept in memory
+		QByteArray xml;
+		{
+			QTextStream xmlStream(&xml);
+			xmlStream.setCodec("UTF-8");
+			outline->dump(xmlStream);
 		}
+		QBuffer xmlBuffer(&xml);
+		xmlBuffer.open(QIODevice::ReadOnly);
 
-		QString path = obj.tocFile.create(".xml");
-		StreamDumper sd(path);
-		outline->dump(sd.stream);
-
-		QFile styleFile(style);
-		if (!styleFile.open(QIODevice::ReadOnly)) {
+		QXmlQuery * query = compiledTocStyleSheet(ps, &xmlBuffer);
+		if (!query) {
 			emit out.error("Could not read the TOC XSL");
 			fail();
+			return;
 		}
 
-		QFile xmlFile(path);
-		if (!xmlFile.open(QIODevice::ReadOnly)) {
-			emit out.error("Could not read the TOC XML");
-			fail();
-		}
+		QByteArray html;
+		QBuffer htmlBuffer(&html);
+		htmlBuffer.open(QIODevice::WriteOnly);
 
-		QString htmlPath = obj.tocFile.create(".html");
-		QFile htmlFile(htmlPath);
-		if (!htmlFile.open(QIODevice::WriteOnly)) {
-			emit out.error("Could not open the TOC for writing");
+		if (!query->evaluateTo(&htmlBuffer) || html.isEmpty()) {
+			emit out.error("Could not apply the TOC XSL");
 			fail();
+			return;
 		}
 
-		QXmlQuery query(QXmlQuery::XSLT20);
-		query.setFocus(&xmlFile);
-		query.setQuery(&styleFile);
-		query.evaluateTo(&htmlFile);
-
-		obj.loaderObject = tocLoader->addResource(htmlPath, ps.load);
+		QString data = QString::fromUtf8(html);
+		obj.loaderObject = tocLoader->addResource(QString(), ps.load, &data);
 		obj.page = &obj.loaderObject->page;
 		PageObject::webPageToObject[obj.page] = &obj;
 		updateWebSettings(obj.page->settings(), ps.web);
@@ -1135,6 +1817,7 @@ void PdfConverterPrivate::printDocument() {
 		i.close();
 		tempOut.removeAll();
 	}
+	dumpNetworkTimings();
 	clearResources();
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 	currentPhase = 6;
@@ -1145,7 +1828,19 @@ void PdfConverterPrivate::printDocument() {
 	conversionDone = true;
 	emit out.finished(true);
 
-	qApp->exit(0); // quit qt's event handling
+	if (quitOnFinished) qApp->exit(0); // quit qt's event handling
+}
+
+/*!
+ * Collect the timings of the page, header, footer and table of content loads
+ */
+QList<NetworkTiming> PdfConverterPrivate::networkTimings() const {
+	QList<NetworkTiming> timings = pageLoader.networkTimings();
+#ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
+	timings << measuringHFLoader.networkTimings() << hfLoader.networkTimings()
+			<< tocLoader1.networkTimings() << tocLoader2.networkTimings();
+#endif
+	return timings;
 }
 
 #if defined(__EXTENSIVE_WKHTMLTOPDF_QT_HACK__) && defined(WKHTMLTOPDF_USE_WEBKIT)
@@ -1290,3 +1985,25 @@ const settings::PdfGlobal & PdfConverter::globalSettings() const {
 ConverterPrivate & PdfConverter::priv() {
 	return *d;
 }
+
+#endif // WKHTMLTOPDF_USE_WEBKIT
+
+/*!
+ * Write the request timings to the file given by settings.dumpNetworkTimings
+ */
+void PdfConverterPrivate::dumpNetworkTimings() {
+	if (settings.dumpNetworkTimings.isEmpty()) return;
+	QFile file(settings.dumpNetworkTimings);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+		file.write(NetworkTiming::toHar(networkTimings())) == -1)
+		emit out.warning(QString("Could not write the network timings to ") + settings.dumpNetworkTimings);
+}
+
+/*!
+  \brief Returns the timing of every request made while loading the last conversion
+*/
+QList<NetworkTiming> PdfConverter::networkTimings() {
+	return d->networkTimings();
+}
+
+#include "dllend.inc"
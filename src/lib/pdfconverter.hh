@@ -22,6 +22,7 @@
 #define __PDFCONVERTER_HH__
 
 #include <converter.hh>
+#include <networktiming.hh>
 #include <pdfsettings.hh>
 
 #include <dllbegin.inc>
@@ -38,6 +39,7 @@ public:
 	void addResource(const settings::PdfObject & pageSettings, const QString * data=0);
 	const settings::PdfGlobal & globalSettings() const;
 	const QByteArray & output();
+	QList<NetworkTiming> networkTimings();
     static const qreal millimeterToPointMultiplier;
 private:
 	PdfConverterPrivate * d;
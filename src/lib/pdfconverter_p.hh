@@ -23,14 +23,19 @@
 
 #include "converter_p.hh"
 #include "multipageloader.hh"
+#include "renderengine.hh"
 #include "outline.hh"
+#include "pdfmerger.hh"
 #include "pdfconverter.hh"
 #include "pdfsettings.hh"
 #include "tempfile.hh"
 #include <QAtomicInt>
+#include <QBuffer>
 #include <QFile>
 #include <QMutex>
+#include <QPageLayout>
 #include <QPainter>
+#include <QPointer>
 #include <QPrinter>
 #include <QRegExp>
 #include <QWaitCondition>
@@ -57,6 +62,15 @@ public:
 #ifdef WKHTMLTOPDF_USE_WEBKIT
 	LoaderObject * loaderObject;
 	QWebPage * page;
+#else
+	LoaderObject * loaderObject;
+	RenderPage * page;
+	//The object printed on its own
+	QByteArray pdf;
+	//Headings listed in the outline below the object
+	QList<HeadingInfo> headings;
+	//Where the named destinations of the printed object point
+	QHash<QByteArray, PdfMerger::Destination> destinations;
 #endif
 	QString data;
 	int number;
@@ -83,7 +97,6 @@ public:
 	QList<QWebPage *> footers;
 #endif
 	int pageCount;
-	TempFile tocFile;
 
 	void clear() {
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
@@ -99,18 +112,21 @@ public:
 		footers.clear();
 		webPageToObject.remove(page);
  		page=0;
+#else
+		page=0;
+		pdf.clear();
+		headings.clear();
+		destinations.clear();
 #endif
-		tocFile.removeAll();
 	}
 
 	PageObject(const settings::PdfObject & set, const QString * d=NULL):
 		settings(set)
-#ifdef WKHTMLTOPDF_USE_WEBKIT
 		, loaderObject(0), page(0)
-#endif
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 		, headerReserveHeight(0), footerReserveHeight(0), measuringHeader(0), measuringFooter(0), web_printer(0)
 #endif
+		, pageCount(0)
 	{
 		if (d) data=*d;
 	};
@@ -135,6 +151,8 @@ public:
 private:
 	PdfConverter & out;
 	void clearResources();
+	QList<NetworkTiming> networkTimings() const;
+	void dumpNetworkTimings();
 	TempFile tempOut;
 	QByteArray outputData;
 
@@ -194,6 +212,7 @@ private:
 #if defined(__EXTENSIVE_WKHTMLTOPDF_QT_HACK__) && defined(WKHTMLTOPDF_USE_WEBKIT)
 	void handleTocPage(PageObject & obj);
 	void preprocessPage(PageObject & obj);
+	void reserveTocPages();
 	void spoolPage(int page);
 	void spoolTo(int page);
 	void handleHeader(QWebPage * frame, int page);
@@ -221,19 +240,73 @@ public slots:
 
 #else
 
-class DLL_LOCAL PdfConverterPrivate : public ConverterPrivate {
-        Q_OBJECT
+class DLL_LOCAL PdfConverterPrivate: public ConverterPrivate {
+	Q_OBJECT
 public:
-        PdfConverterPrivate(settings::PdfGlobal & s, PdfConverter & o);
+	PdfConverterPrivate(settings::PdfGlobal & s, PdfConverter & o);
+	~PdfConverterPrivate();
+
+	settings::PdfGlobal & settings;
 
-        settings::PdfGlobal & settings;
-        QByteArray outputData;
+	MultiPageLoader pageLoader;
+	//Loads the tables of content once every other object is printed
+	MultiPageLoader tocLoader;
 
 private:
-        PdfConverter & out;
-        void clearResources();
-        void beginConvert();
-        Converter & outer();
+	PdfConverter & out;
+	void clearResources();
+	QList<NetworkTiming> networkTimings() const;
+	void dumpNetworkTimings();
+	QByteArray outputData;
+
+	QList<PageObject> objects;
+	QSize viewportSize;
+	QPageLayout layout;
+	//Number of objects being printed right now
+	int printing;
+	int printed;
+	int toPrint;
+	int nextObject;
+	//Index of the next object to append to the output
+	int nextMerge;
+	int pageCount;
+	//Number of tables of content, how many of them are printed and how often they were rendered
+	int tocs;
+	int tocsDone;
+	int tocRenderings;
+	//The outline the tables of content were last rendered from
+	QByteArray tocOutline;
+
+	QFile outFile;
+	QBuffer outBuffer;
+	PdfMerger * merger;
+
+	QPageLayout pageLayout() const;
+	void printNext();
+	void printWithHeadings(int d);
+	void printObject(int d);
+	void objectPrinted(int d, const QByteArray & pdf);
+	bool printable(const PageObject & obj) const;
+	bool inOutline(const PageObject & obj) const;
+	bool needsOutline() const;
+	bool listsHeadings(const PageObject & obj) const;
+	QByteArray outlineXml(QList<int> & entries) const;
+	int guessTocPages(const settings::PdfObject & ps, const QList<int> & entries) const;
+	bool tocHtml(const settings::PdfObject & ps, const QByteArray & xml, QByteArray & html);
+	void loadTocs();
+	void tocsPrinted();
+	bool openOutput();
+	bool mergePrinted();
+public slots:
+	void pagesLoaded(bool ok);
+	void tocLoaded(bool ok);
+	void printDocument();
+
+	void beginConvert();
+
+	friend class PdfConverter;
+
+	virtual Converter & outer();
 };
 #endif
 
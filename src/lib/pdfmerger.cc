@@ -0,0 +1,856 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "pdfmerger.hh"
+#include <QCryptographicHash>
+#include <QSet>
+#include <algorithm>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+
+/*!
+  \file pdfmerger.hh
+  \brief Defines the PdfMerger class
+*/
+
+enum TokenType {
+	NumberToken,
+	NameToken,
+	StringToken,
+	KeywordToken,
+	DelimiterToken
+};
+
+struct Token {
+	TokenType type;
+	int start;
+	int end;
+};
+
+static bool isSpace(char c) {
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+static bool isDelimiter(char c) {
+	return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' ||
+		c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+/*!
+  \brief Read the token starting at or after pos
+  \returns false when the end of the data is reached
+*/
+static bool nextToken(const QByteArray & d, int & pos, Token & t) {
+	const int n = d.size();
+	while (pos < n) {
+		if (isSpace(d[pos])) ++pos;
+		else if (d[pos] == '%') {
+			while (pos < n && d[pos] != '\n' && d[pos] != '\r') ++pos;
+		} else break;
+	}
+	if (pos >= n) return false;
+	t.start = pos;
+	char c = d[pos];
+	if (c == '(') {
+		int depth = 0;
+		for (; pos < n; ++pos) {
+			if (d[pos] == '\\') ++pos;
+			else if (d[pos] == '(') ++depth;
+			else if (d[pos] == ')' && --depth == 0) break;
+		}
+		pos = qMin(pos + 1, n);
+		t.type = StringToken;
+	} else if (c == '<' && pos + 1 < n && d[pos+1] == '<') {
+		pos += 2;
+		t.type = DelimiterToken;
+	} else if (c == '>' && pos + 1 < n && d[pos+1] == '>') {
+		pos += 2;
+		t.type = DelimiterToken;
+	} else if (c == '<') {
+		while (pos < n && d[pos] != '>') ++pos;
+		pos = qMin(pos + 1, n);
+		t.type = StringToken;
+	} else if (c == '/') {
+		++pos;
+		while (pos < n && !isSpace(d[pos]) && !isDelimiter(d[pos])) ++pos;
+		t.type = NameToken;
+	} else if (isDelimiter(c)) {
+		++pos;
+		t.type = DelimiterToken;
+	} else {
+		bool number = true;
+		while (pos < n && !isSpace(d[pos]) && !isDelimiter(d[pos])) {
+			char x = d[pos++];
+			number = number && ((x >= '0' && x <= '9') || x == '.' || x == '-' || x == '+');
+		}
+		t.type = number ? NumberToken : KeywordToken;
+	}
+	t.end = pos;
+	return true;
+}
+
+static QList<Token> tokenize(const QByteArray & d) {
+	QList<Token> tokens;
+	Token t;
+	int pos = 0;
+	while (nextToken(d, pos, t)) tokens << t;
+	return tokens;
+}
+
+static bool is(const QByteArray & d, const Token & t, const char * text) {
+	return d.mid(t.start, t.end - t.start) == text;
+}
+
+static bool isInteger(const QByteArray & d, const Token & t) {
+	if (t.type != NumberToken) return false;
+	for (int i = t.start; i < t.end; ++i)
+		if (d[i] < '0' || d[i] > '9') return false;
+	return true;
+}
+
+/*!
+  \brief Is token i the start of an indirect reference "n g R"
+*/
+static bool isReference(const QByteArray & d, const QList<Token> & tokens, int i) {
+	return i + 2 < tokens.size() && isInteger(d, tokens[i]) && isInteger(d, tokens[i+1]) &&
+		tokens[i+2].type == KeywordToken && is(d, tokens[i+2], "R");
+}
+
+/*!
+  \brief Find the index of the token following the value starting at token i
+*/
+static int valueEnd(const QByteArray & d, const QList<Token> & tokens, int i) {
+	if (i >= tokens.size()) return i;
+	if (isReference(d, tokens, i)) return i + 3;
+	if (tokens[i].type != DelimiterToken || !(is(d, tokens[i], "<<") || is(d, tokens[i], "[")))
+		return i + 1;
+	int depth = 0;
+	for (; i < tokens.size(); ++i) {
+		if (tokens[i].type != DelimiterToken) continue;
+		if (is(d, tokens[i], "<<") || is(d, tokens[i], "[")) ++depth;
+		else if ((is(d, tokens[i], ">>") || is(d, tokens[i], "]")) && --depth == 0) return i + 1;
+	}
+	return i;
+}
+
+/*!
+  \brief Can text be written as a name without escaping
+*/
+static bool isName(const QByteArray & text) {
+	for (int i = 0; i < text.size(); ++i)
+		if (text[i] <= ' ' || text[i] > '~' || text[i] == '#' || isDelimiter(text[i])) return false;
+	return !text.isEmpty();
+}
+
+/*!
+  \brief Look up the value of a key in a dictionary
+  \param dict The dictionary text
+  \param key The key without leading slash
+  \returns The text of the value or an empty array
+*/
+static QByteArray dictValue(const QByteArray & dict, const char * key) {
+	QList<Token> tokens = tokenize(dict);
+	if (tokens.isEmpty() || !is(dict, tokens[0], "<<")) return QByteArray();
+	QByteArray name = QByteArray("/") + key;
+	int i = 1;
+	while (i < tokens.size() && !is(dict, tokens[i], ">>")) {
+		int e = valueEnd(dict, tokens, i + 1);
+		if (tokens[i].type == NameToken && is(dict, tokens[i], name.constData()) && e > i + 1)
+			return dict.mid(tokens[i+1].start, tokens[e-1].end - tokens[i+1].start);
+		i = e;
+	}
+	return QByteArray();
+}
+
+/*!
+  \brief Get the object number of an "n g R" reference, -1 if it is not one
+*/
+static int referenceNumber(const QByteArray & value) {
+	QList<Token> tokens = tokenize(value);
+	if (tokens.size() != 3 || !isReference(value, tokens, 0)) return -1;
+	return value.mid(tokens[0].start, tokens[0].end - tokens[0].start).toInt();
+}
+
+/*!
+  \brief Rewrite every indirect reference in text through map
+*/
+static QByteArray renumber(const QByteArray & text, const QHash<int, int> & map) {
+	QList<Token> tokens = tokenize(text);
+	QByteArray res;
+	int last = 0;
+	for (int i = 0; i < tokens.size(); ++i) {
+		if (!isReference(text, tokens, i)) continue;
+		int old = text.mid(tokens[i].start, tokens[i].end - tokens[i].start).toInt();
+		res.append(text.mid(last, tokens[i].start - last));
+		//References to objects that are not copied become null, as the spec mandates
+		if (map.contains(old))
+			res.append(QByteArray::number(map[old]) + " 0 R");
+		else
+			res.append("null");
+		last = tokens[i+2].end;
+		i += 2;
+	}
+	res.append(text.mid(last));
+	return res;
+}
+
+/*!
+  \brief Split a PDF file into its objects and trailer dictionary
+*/
+bool PdfMerger::parse(const QByteArray & pdf, QHash<int, Object> & objects, QByteArray & trailer) {
+	Token t;
+	Token prev[2];
+	int seen = 0;
+	int pos = 0;
+	while (nextToken(pdf, pos, t)) {
+		if (t.type == KeywordToken && is(pdf, t, "obj") && seen >= 2 &&
+			isInteger(pdf, prev[0]) && isInteger(pdf, prev[1])) {
+			int number = pdf.mid(prev[0].start, prev[0].end - prev[0].start).toInt();
+			Object & o = objects[number];
+			int valueStart = pos;
+			int valueStop = -1;
+			while (nextToken(pdf, pos, t)) {
+				if (t.type != KeywordToken) continue;
+				if (is(pdf, t, "endobj")) {
+					valueStop = t.start;
+					break;
+				}
+				if (!is(pdf, t, "stream")) continue;
+				valueStop = t.start;
+				int s = t.end;
+				if (s < pdf.size() && pdf[s] == '\r') ++s;
+				if (s < pdf.size() && pdf[s] == '\n') ++s;
+				o.value = pdf.mid(valueStart, valueStop - valueStart).trimmed();
+				bool ok = false;
+				int length = dictValue(o.value, "Length").toInt(&ok);
+				int e = ok ? s + length : -1;
+				if (!ok || pdf.indexOf("endstream", e) < 0 ||
+					pdf.mid(e, pdf.indexOf("endstream", e) - e).trimmed().size() != 0) {
+					//Indirect or wrong length, trust the endstream keyword instead
+					e = pdf.indexOf("endstream", s);
+					if (e < 0) return false;
+					if (e > s && pdf[e-1] == '\n') --e;
+					if (e > s && pdf[e-1] == '\r') --e;
+				}
+				o.stream = pdf.mid(s, e - s);
+				o.hasStream = true;
+				pos = pdf.indexOf("endstream", e) + 9;
+				int end = pdf.indexOf("endobj", pos);
+				if (end < 0) return false;
+				pos = end + 6;
+				break;
+			}
+			if (valueStop < 0) return false;
+			if (!o.hasStream) o.value = pdf.mid(valueStart, valueStop - valueStart).trimmed();
+			if (dictValue(o.value, "Type") == "/ObjStm") return false;
+			if (dictValue(o.value, "Type") == "/XRef" && trailer.isEmpty()) trailer = o.value;
+			seen = 0;
+			continue;
+		}
+		if (t.type == KeywordToken && is(pdf, t, "trailer")) {
+			Token u;
+			int p = pos;
+			if (!nextToken(pdf, p, u) || !is(pdf, u, "<<")) return false;
+			int depth = 0;
+			int start = u.start;
+			do {
+				if (is(pdf, u, "<<")) ++depth;
+				else if (is(pdf, u, ">>")) --depth;
+			} while (depth > 0 && nextToken(pdf, p, u));
+			trailer = pdf.mid(start, u.end - start);
+			pos = p;
+			seen = 0;
+			continue;
+		}
+		//Remember the two tokens preceding the next one
+		prev[0] = prev[1];
+		prev[1] = t;
+		++seen;
+	}
+	return !trailer.isEmpty();
+}
+
+/*!
+  \brief Get the object numbers of every reference in text
+*/
+static QList<int> references(const QByteArray & text) {
+	QList<Token> tokens = tokenize(text);
+	QList<int> res;
+	for (int i = 0; i < tokens.size(); ++i)
+		if (isReference(text, tokens, i))
+			res << text.mid(tokens[i].start, tokens[i].end - tokens[i].start).toInt();
+	return res;
+}
+
+/*!
+  \brief Get the key of a name or string token as used for named destinations
+*/
+static QByteArray destinationName(const QByteArray & d, const Token & t) {
+	if (t.type == NameToken) return d.mid(t.start + 1, t.end - t.start - 1);
+	if (t.type == StringToken && d[t.start] == '(') return d.mid(t.start + 1, t.end - t.start - 2);
+	return QByteArray();
+}
+
+/*!
+  \brief Replace named destinations in link annotations and actions by explicit ones
+
+  Names are only unique within the document they came from, explicit
+  destinations refer to page objects and survive the renumbering.
+  \param missing Receives the names the document does not hold
+*/
+static QByteArray resolveDestinations(const QByteArray & text, const QHash<QByteArray, QByteArray> & dests,
+									  QSet<QByteArray> & missing) {
+	if (!text.contains("/D")) return text;
+	QList<Token> tokens = tokenize(text);
+	QByteArray res;
+	int last = 0;
+	for (int i = 1; i < tokens.size(); ++i) {
+		if (tokens[i-1].type != NameToken ||
+			!(is(text, tokens[i-1], "/Dest") || is(text, tokens[i-1], "/D"))) continue;
+		QByteArray name = destinationName(text, tokens[i]);
+		if (name.isEmpty()) continue;
+		if (!dests.contains(name)) {
+			missing << name;
+			continue;
+		}
+		res.append(text.mid(last, tokens[i].start - last));
+		res.append(dests[name]);
+		last = tokens[i].end;
+	}
+	res.append(text.mid(last));
+	return res;
+}
+
+/*!
+  \brief Remove a key and its value from a dictionary
+*/
+static QByteArray withoutKey(const QByteArray & dict, const char * key) {
+	QList<Token> tokens = tokenize(dict);
+	if (tokens.isEmpty() || !is(dict, tokens[0], "<<")) return dict;
+	QByteArray name = QByteArray("/") + key;
+	int i = 1;
+	while (i < tokens.size() && !is(dict, tokens[i], ">>")) {
+		int e = valueEnd(dict, tokens, i + 1);
+		if (tokens[i].type == NameToken && is(dict, tokens[i], name.constData()) && e > i + 1)
+			return dict.left(tokens[i].start) + dict.mid(tokens[e-1].end);
+		i = e;
+	}
+	return dict;
+}
+
+/*!
+  \brief Collect the named destinations listed in the catalog of a document
+  \param dests Receives the explicit destination of every name
+  \returns The number of the object holding the names, -1 if they are in the catalog
+*/
+int PdfMerger::namedDestinations(const QHash<int, Object> & objs, int catalog, QHash<QByteArray, QByteArray> & dests) {
+	QByteArray d = dictValue(objs.value(catalog).value, "Dests");
+	int destsObj = referenceNumber(d);
+	if (destsObj != -1) d = objs.value(destsObj).value;
+	QList<Token> tokens = tokenize(d);
+	for (int i = 1; i + 1 < tokens.size() && tokens[i].type == NameToken; ) {
+		int e = valueEnd(d, tokens, i + 1);
+		if (e <= i + 1) break;
+		QByteArray v = d.mid(tokens[i+1].start, tokens[e-1].end - tokens[i+1].start);
+		int r = referenceNumber(v);
+		if (r != -1) v = objs.value(r).value;
+		if (!dictValue(v, "D").isEmpty()) v = dictValue(v, "D");
+		dests[destinationName(d, tokens[i])] = v;
+		i = e;
+	}
+	return destsObj;
+}
+
+/*!
+  \brief Get the distance from the top of the page an explicit destination points at
+  \param dest The destination array
+  \param height The height of the page it points at
+  \returns The distance in points, -1 if the destination does not give one
+*/
+static qreal destinationTop(const QByteArray & dest, qreal height) {
+	QList<Token> tokens = tokenize(dest);
+	if (tokens.size() < 6 || !isReference(dest, tokens, 1)) return -1;
+	int i = -1;
+	if (is(dest, tokens[4], "/XYZ")) i = 6;
+	else if (is(dest, tokens[4], "/FitH") || is(dest, tokens[4], "/FitBH")) i = 5;
+	if (i == -1 || i >= tokens.size() || tokens[i].type != NumberToken) return -1;
+	return qMax<qreal>(0, height - dest.mid(tokens[i].start, tokens[i].end - tokens[i].start).toDouble());
+}
+
+/*!
+  \brief Collect the leaf pages below a page tree node in order
+
+  The attributes a page inherits from the nodes above it are copied into
+  its dictionary, so the page no longer depends on the page tree.
+  \param nodes Receives the nodes of the page tree that are not pages
+*/
+void PdfMerger::collectPages(const QHash<int, Object> & objs, int node, QHash<QByteArray, QByteArray> inherited,
+							 QList<int> & leaves, QList<QByteArray> & bodies, QList<qreal> & heights,
+							 QSet<int> & nodes, int depth) {
+	static const char * inheritable[] = {"Resources", "MediaBox", "CropBox", "Rotate"};
+	if (!objs.contains(node) || depth > 64) return;
+	const QByteArray & v = objs[node].value;
+	if (dictValue(v, "Type") == "/Pages") {
+		nodes << node;
+		for (int i = 0; i < 4; ++i) {
+			QByteArray value = dictValue(v, inheritable[i]);
+			if (!value.isEmpty()) inherited[inheritable[i]] = value;
+		}
+		foreach (int kid, references(dictValue(v, "Kids")))
+			collectPages(objs, kid, inherited, leaves, bodies, heights, nodes, depth + 1);
+		return;
+	}
+	QByteArray body = withoutKey(v, "Parent");
+	for (int i = 0; i < 4; ++i)
+		if (dictValue(body, inheritable[i]).isEmpty() && inherited.contains(inheritable[i]))
+			body.insert(body.indexOf("<<") + 2, QByteArray(" /") + inheritable[i] + " " + inherited[inheritable[i]]);
+
+	QByteArray mediaBox = dictValue(body, "MediaBox");
+	QList<Token> tokens = tokenize(mediaBox);
+	qreal height = 792;
+	if (tokens.size() == 6)
+		height = mediaBox.mid(tokens[4].start, tokens[4].end - tokens[4].start).toDouble() -
+			mediaBox.mid(tokens[2].start, tokens[2].end - tokens[2].start).toDouble();
+	leaves << node;
+	bodies << body;
+	heights << height;
+}
+
+/*!
+  \brief Encode a string as a PDF text string
+*/
+static QByteArray textString(const QString & s) {
+	QByteArray r("<FEFF");
+	foreach (const QChar & c, s)
+		r.append(QByteArray::number(c.unicode(), 16).rightJustified(4, '0').toUpper());
+	r.append(">");
+	return r;
+}
+
+PdfMerger::PdfMerger(QIODevice * o):
+	out(o), written(0), pages(0), info(-1), pageOffset(0), copies(1), collate(true) {}
+
+/*!
+  \brief Reserve an object number in the output
+*/
+int PdfMerger::reserve() {
+	offsets << -1;
+	return offsets.size();
+}
+
+/*!
+  \brief Write an object to the output device
+*/
+bool PdfMerger::write(int number, const QByteArray & body) {
+	QByteArray head = QByteArray::number(number) + " 0 obj\n";
+	offsets[number-1] = written;
+	if (out->write(head) != head.size() ||
+		out->write(body) != body.size() ||
+		out->write("\nendobj\n") != 8) {
+		error = "Unable to write to destination";
+		return false;
+	}
+	written += head.size() + body.size() + 8;
+	return true;
+}
+
+/*!
+  \brief Append all the pages of a document and write its objects
+
+  Objects that are byte for byte identical to one already written, after
+  renumbering, are not written again. This shares fonts and images between
+  the documents.
+  \param pdf The document
+  \returns false if the document could not be understood or written
+*/
+bool PdfMerger::append(const QByteArray & pdf) {
+	QHash<int, Object> objs;
+	QByteArray trailer;
+	if (!pdf.startsWith("%PDF-") || !parse(pdf, objs, trailer)) {
+		error = "Unable to parse the printed document";
+		return false;
+	}
+
+	int catalog = referenceNumber(dictValue(trailer, "Root"));
+	int root = objs.contains(catalog) ? referenceNumber(dictValue(objs[catalog].value, "Pages")) : -1;
+	if (!objs.contains(root)) {
+		error = "The printed document has no pages";
+		return false;
+	}
+
+	if (written == 0) {
+		version = pdf.mid(5, pdf.indexOf('\n') - 5).trimmed();
+		QByteArray header = "%PDF-" + version + "\n%\xe2\xe3\xcf\xd3\n";
+		if (out->write(header) != header.size()) {
+			error = "Unable to write to destination";
+			return false;
+		}
+		written = header.size();
+		//The catalog and the root of the page tree are written by finish
+		reserve();
+		reserve();
+	}
+
+	//Objects that are replaced by our own
+	QSet<int> skip;
+	skip << catalog;
+	QHash<QByteArray, QByteArray> dests;
+	int destsObj = namedDestinations(objs, catalog, dests);
+	if (destsObj != -1) skip << destsObj;
+
+	QList<int> numbers = objs.keys();
+	std::sort(numbers.begin(), numbers.end());
+	foreach (int n, numbers) {
+		if (skip.contains(n)) continue;
+		if (dictValue(objs[n].value, "Type") == "/XRef") skip << n;
+		else objs[n].value = resolveDestinations(objs[n].value, dests, unresolved);
+	}
+
+	//The page tree is replaced by our own, the pages are written by finish
+	QList<int> leaves;
+	QList<QByteArray> bodies;
+	QList<qreal> heights;
+	QSet<int> nodes;
+	collectPages(objs, root, QHash<QByteArray, QByteArray>(), leaves, bodies, heights, nodes);
+	skip += nodes;
+	QSet<int> leafSet = leaves.toSet();
+
+	//Find objects identical to ones already written, an object can only
+	//match when everything it refers to has been matched already
+	QHash<int, int> map;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		foreach (int n, numbers) {
+			if (skip.contains(n) || map.contains(n) || leafSet.contains(n)) continue;
+			bool resolved = true;
+			foreach (int r, references(objs[n].value))
+				resolved = resolved && map.contains(r);
+			if (!resolved) continue;
+			QByteArray body = renumber(objs[n].value, map);
+			if (objs[n].hasStream) body += "\nstream\n" + objs[n].stream + "\nendstream";
+			QByteArray h = QCryptographicHash::hash(body, QCryptographicHash::Sha1);
+			if (!hashes.contains(h)) continue;
+			map[n] = hashes[h];
+			changed = true;
+		}
+	}
+
+	QList<int> fresh;
+	foreach (int n, numbers) {
+		if (skip.contains(n) || map.contains(n)) continue;
+		map[n] = reserve();
+		fresh << n;
+	}
+
+	foreach (int n, fresh) {
+		if (leafSet.contains(n)) continue;
+		const Object & o = objs[n];
+		QByteArray body = renumber(o.value, map);
+		if (o.hasStream) body += "\nstream\n" + o.stream + "\nendstream";
+		hashes[QCryptographicHash::hash(body, QCryptographicHash::Sha1)] = map[n];
+		if (!write(map[n], body)) return false;
+	}
+
+	//Another document may link to the names, the first one holding a name wins
+	for (QHash<QByteArray, QByteArray>::const_iterator i = dests.begin(); i != dests.end(); ++i)
+		if (!named.contains(i.key())) named[i.key()] = renumber(i.value(), map);
+
+	foreach (int leaf, leaves) pageObjects << map[leaf];
+	foreach (const QByteArray & body, bodies) {
+		//Annotations other than form fields are cloned for every copy of the page
+		QList<QByteArray> annots;
+		QByteArray a = dictValue(body, "Annots");
+		int arrayObj = referenceNumber(a);
+		if (arrayObj != -1) a = objs.value(arrayObj).value;
+		foreach (int n, references(a)) {
+			if (!objs.contains(n) || dictValue(objs[n].value, "Subtype") == "/Widget") continue;
+			annots << renumber(objs[n].value, map);
+		}
+		pageAnnots << annots;
+		QByteArray b = renumber(body, map);
+		pageBodies << b.insert(b.indexOf("<<") + 2, " /Parent 2 0 R");
+	}
+	pageHeights << heights;
+	pages += leaves.size();
+
+	int i = referenceNumber(dictValue(trailer, "Info"));
+	if (info == -1 && map.contains(i)) info = map[i];
+	return true;
+}
+
+/*!
+  \brief Find where the named destinations of a document point, without appending it
+
+  The renderer writes a named destination for every element that a link of
+  the document points at, placed where the element was printed.
+  \param pdf The document
+  \param pages Receives the number of pages of the document
+  \param dests Receives every named destination pointing at one of its pages
+  \returns false if the document could not be understood
+*/
+bool PdfMerger::destinations(const QByteArray & pdf, int & pages, QHash<QByteArray, Destination> & dests) {
+	QHash<int, Object> objs;
+	QByteArray trailer;
+	if (!pdf.startsWith("%PDF-") || !parse(pdf, objs, trailer)) return false;
+	int catalog = referenceNumber(dictValue(trailer, "Root"));
+	int root = objs.contains(catalog) ? referenceNumber(dictValue(objs[catalog].value, "Pages")) : -1;
+	if (!objs.contains(root)) return false;
+
+	QList<int> leaves;
+	QList<QByteArray> bodies;
+	QList<qreal> heights;
+	QSet<int> nodes;
+	collectPages(objs, root, QHash<QByteArray, QByteArray>(), leaves, bodies, heights, nodes);
+	pages = leaves.size();
+
+	QHash<QByteArray, QByteArray> named;
+	namedDestinations(objs, catalog, named);
+	for (QHash<QByteArray, QByteArray>::const_iterator i = named.begin(); i != named.end(); ++i) {
+		Destination d;
+		d.page = leaves.indexOf(references(i.value()).value(0, -1));
+		if (d.page == -1) continue;
+		d.top = destinationTop(i.value(), heights[d.page]);
+		dests[i.key()] = d;
+	}
+	return true;
+}
+
+/*!
+  \brief Add an entry to the outline of the merged document
+  \param title The text of the entry
+  \param level The depth of the entry, 0 is the top level
+  \param page The zero based index of the page the entry points at
+  \param top The distance in points from the top of the page, -1 for the top
+*/
+void PdfMerger::addOutlineEntry(const QString & title, int level, int page, qreal top) {
+	OutlineEntry e;
+	e.title = title;
+	e.level = level;
+	e.page = page;
+	e.top = top;
+	outline << e;
+}
+
+/*!
+  \brief Set the title stored in the document information
+*/
+void PdfMerger::setTitle(const QString & t) {
+	title = t;
+}
+
+/*!
+  \brief Print every page more than once
+
+  The pages of every copy share the contents and resources of the first,
+  only their page dictionaries and annotations are written again. Form
+  fields are left out of the copies, repeating them would need new fields
+  with names of their own.
+  \param c The number of copies
+  \param col Print the copies one after another, instead of repeating every page
+*/
+void PdfMerger::setCopies(int c, bool col) {
+	copies = qMax(1, c);
+	collate = col;
+}
+
+/*!
+  \brief Let the page labels start at 1 + offset, which may be 0 or below
+*/
+void PdfMerger::setPageOffset(int offset) {
+	pageOffset = offset;
+}
+
+/*!
+  \brief Write the outline tree
+  \returns The object number of the outline root, 0 if there is no outline
+*/
+int PdfMerger::writeOutline() {
+	QList<int> entries;
+	for (int i = 0; i < outline.size(); ++i)
+		if (outline[i].page >= 0 && outline[i].page < pageObjects.size()) entries << i;
+	if (entries.isEmpty()) return 0;
+
+	int rootNumber = reserve();
+	QList<int> number, parent, first, last, prev, next, count;
+	QList<int> stack;
+	int lastTop = -1;
+	for (int k = 0; k < entries.size(); ++k) {
+		number << reserve();
+		first << -1;
+		last << -1;
+		prev << -1;
+		next << -1;
+		count << 0;
+		while (!stack.isEmpty() && outline[entries[stack.last()]].level >= outline[entries[k]].level)
+			stack.removeLast();
+		int p = stack.isEmpty() ? -1 : stack.last();
+		parent << p;
+		for (int a = p; a != -1; a = parent[a]) ++count[a];
+		int sibling = p == -1 ? lastTop : last[p];
+		if (p == -1) lastTop = k;
+		if (sibling != -1) {
+			next[sibling] = k;
+			prev[k] = sibling;
+		}
+		if (p != -1) {
+			if (first[p] == -1) first[p] = k;
+			last[p] = k;
+		}
+		stack << k;
+	}
+
+	int topFirst = -1;
+	for (int k = 0; k < entries.size(); ++k) {
+		const OutlineEntry & e = outline[entries[k]];
+		if (parent[k] == -1 && topFirst == -1) topFirst = k;
+		QByteArray body = "<< /Title " + textString(e.title);
+		body += " /Parent " + QByteArray::number(parent[k] == -1 ? rootNumber : number[parent[k]]) + " 0 R";
+		if (prev[k] != -1) body += " /Prev " + QByteArray::number(number[prev[k]]) + " 0 R";
+		if (next[k] != -1) body += " /Next " + QByteArray::number(number[next[k]]) + " 0 R";
+		if (first[k] != -1) {
+			body += " /First " + QByteArray::number(number[first[k]]) + " 0 R";
+			body += " /Last " + QByteArray::number(number[last[k]]) + " 0 R";
+			body += " /Count " + QByteArray::number(count[k]);
+		}
+		body += " /Dest [" + QByteArray::number(pageObjects[e.page]) + " 0 R /XYZ null ";
+		body += e.top < 0 ? QByteArray("null") : QByteArray::number(pageHeights[e.page] - e.top, 'f', 2);
+		body += " null] >>";
+		if (!write(number[k], body)) return -1;
+	}
+	QByteArray body = "<< /Type /Outlines /First " + QByteArray::number(number[topFirst]) + " 0 R /Last " +
+		QByteArray::number(number[lastTop]) + " 0 R /Count " + QByteArray::number(entries.size()) + " >>";
+	if (!write(rootNumber, body)) return -1;
+	return rootNumber;
+}
+
+/*!
+  \brief Write the page tree, catalog and cross reference table
+*/
+bool PdfMerger::finish() {
+	if (written == 0) {
+		error = "No pages to print";
+		return false;
+	}
+
+	int outlines = writeOutline();
+	if (outlines < 0) return false;
+
+	if (!title.isEmpty()) {
+		info = reserve();
+		if (!write(info, "<< /Title " + textString(title) + " /Creator (wkhtmltopdf) >>")) return false;
+	}
+
+	QByteArray kids;
+	int outer = collate ? copies : 1;
+	int inner = collate ? 1 : copies;
+	for (int o = 0; o < outer; ++o)
+		for (int p = 0; p < pages; ++p)
+			for (int i = 0; i < inner; ++i) {
+				if (o + i == 0) {
+					if (!write(pageObjects[p], pageBodies[p])) return false;
+					kids += QByteArray::number(pageObjects[p]) + " 0 R ";
+					continue;
+				}
+				//An annotation belongs to a single page, copies get their own
+				int number = reserve();
+				QByteArray body = withoutKey(pageBodies[p], "Annots");
+				QByteArray annots;
+				foreach (const QByteArray & annot, pageAnnots[p]) {
+					int a = reserve();
+					QByteArray b = withoutKey(annot, "P");
+					b.insert(b.indexOf("<<") + 2, " /P " + QByteArray::number(number) + " 0 R");
+					if (!write(a, b)) return false;
+					annots += QByteArray::number(a) + " 0 R ";
+				}
+				if (!annots.isEmpty())
+					body.insert(body.indexOf("<<") + 2, " /Annots [" + annots.trimmed() + "]");
+				if (!write(number, body)) return false;
+				kids += QByteArray::number(number) + " 0 R ";
+			}
+	if (!write(2, "<< /Type /Pages /Kids [" + kids.trimmed() + "] /Count " +
+			   QByteArray::number(pages * copies) + " >>"))
+		return false;
+
+	//Names a document links to, but another document holds
+	QList<QByteArray> names = unresolved.toList();
+	std::sort(names.begin(), names.end());
+	QByteArray dests;
+	foreach (const QByteArray & name, names)
+		if (named.contains(name) && isName(name))
+			dests += "/" + name + " " + named[name] + " ";
+	int destsObj = 0;
+	if (!dests.isEmpty()) {
+		destsObj = reserve();
+		if (!write(destsObj, "<< " + dests.trimmed() + " >>")) return false;
+	}
+
+	QByteArray catalog = "<< /Type /Catalog /Pages 2 0 R";
+	if (outlines != 0) catalog += " /Outlines " + QByteArray::number(outlines) + " 0 R /PageMode /UseOutlines";
+	if (destsObj != 0) catalog += " /Dests " + QByteArray::number(destsObj) + " 0 R";
+	if (pageOffset != 0) {
+		//Numeric labels start at 1, pages numbered 0 or below are labelled one by one
+		int total = pages * copies;
+		int first = qMax(0, -pageOffset);
+		QByteArray nums;
+		for (int i = 0; i < first && i < total; ++i)
+			nums += QByteArray::number(i) + " << /P (" + QByteArray::number(i + 1 + pageOffset) + ") >> ";
+		if (first < total)
+			nums += QByteArray::number(first) + " << /S /D /St " + QByteArray::number(first + 1 + pageOffset) + " >>";
+		catalog += " /PageLabels << /Nums [" + nums.trimmed() + "] >>";
+	}
+	catalog += " >>";
+	if (!write(1, catalog)) return false;
+
+	QByteArray xref = "xref\n0 " + QByteArray::number(offsets.size() + 1) + "\n0000000000 65535 f \n";
+	foreach (qint64 o, offsets)
+		xref += o < 0 ? QByteArray("0000000000 65535 f \n") :
+			QByteArray::number(o).rightJustified(10, '0') + " 00000 n \n";
+	xref += "trailer\n<< /Size " + QByteArray::number(offsets.size() + 1) + " /Root 1 0 R";
+	if (info != -1) xref += " /Info " + QByteArray::number(info) + " 0 R";
+	xref += " >>\nstartxref\n" + QByteArray::number(written) + "\n%%EOF\n";
+	if (out->write(xref) != xref.size()) {
+		error = "Unable to write to destination";
+		return false;
+	}
+	return true;
+}
+
+/*!
+  \brief The number of pages appended so far
+
+  This is the length of a single copy, also when more are printed, so it can
+  be used to find the first page of the next document appended. The finished
+  document holds this many pages times the number of copies.
+*/
+int PdfMerger::pageCount() const {
+	return pages;
+}
+
+/*!
+  \brief Describe why the last operation failed
+*/
+QString PdfMerger::errorString() const {
+	return error;
+}
+
+}
+#include "dllend.inc"
@@ -0,0 +1,118 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __PDFMERGER_HH__
+#define __PDFMERGER_HH__
+
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+
+/*!
+  \brief Joins the PDF documents printed for each object into one
+
+  Every appended document is written to the output device right away, only
+  the page dictionaries and annotations, the outline, the named destinations and the
+  hashes of the written objects are kept until finish writes the pages, the catalog
+  and the cross reference table.
+
+  Only what is needed for the output of the renderer is supported: objects
+  must be stored directly in the file, object streams are rejected.
+*/
+class DLL_LOCAL PdfMerger {
+public:
+	//Where a named destination of a document points
+	struct Destination {
+		//Zero based index of the page
+		int page;
+		//Distance in points from the top of the page, -1 for the top
+		qreal top;
+	};
+
+	PdfMerger(QIODevice * out);
+	static bool destinations(const QByteArray & pdf, int & pages, QHash<QByteArray, Destination> & dests);
+	bool append(const QByteArray & pdf);
+	void addOutlineEntry(const QString & title, int level, int page, qreal top=-1);
+	void setTitle(const QString & title);
+	void setPageOffset(int offset);
+	void setCopies(int copies, bool collate);
+	bool finish();
+	int pageCount() const;
+	QString errorString() const;
+private:
+	struct Object {
+		QByteArray value;
+		QByteArray stream;
+		bool hasStream;
+		Object(): hasStream(false) {}
+	};
+
+	struct OutlineEntry {
+		QString title;
+		int level;
+		int page;
+		qreal top;
+	};
+
+	static bool parse(const QByteArray & pdf, QHash<int, Object> & objects, QByteArray & trailer);
+	static int namedDestinations(const QHash<int, Object> & objects, int catalog, QHash<QByteArray, QByteArray> & dests);
+	static void collectPages(const QHash<int, Object> & objects, int node, QHash<QByteArray, QByteArray> inherited,
+							 QList<int> & leaves, QList<QByteArray> & bodies, QList<qreal> & heights,
+							 QSet<int> & nodes, int depth=0);
+	int reserve();
+	bool write(int number, const QByteArray & body);
+	int writeOutline();
+
+	QIODevice * out;
+	qint64 written;
+	QByteArray version;
+	//Offset of every object in the output, indexed by object number - 1
+	QList<qint64> offsets;
+	//Output object number of everything written so far, by content hash
+	QHash<QByteArray, int> hashes;
+	QList<int> pageObjects;
+	//Dictionaries of the pages, written by finish
+	QList<QByteArray> pageBodies;
+	//Annotations of every page, other than form fields, cloned for the copies
+	QList<QList<QByteArray> > pageAnnots;
+	QList<qreal> pageHeights;
+	//Explicit destination of every name of the documents appended so far
+	QHash<QByteArray, QByteArray> named;
+	//Names linked to that the document linking does not hold
+	QSet<QByteArray> unresolved;
+	QList<OutlineEntry> outline;
+	int pages;
+	int info;
+	int pageOffset;
+	int copies;
+	bool collate;
+	QString title;
+	QString error;
+};
+
+}
+#include "dllend.inc"
+#endif //__PDFMERGER_HH__
@@ -121,6 +121,7 @@ struct DLL_LOCAL ReflectImpl<PdfGlobal>: public ReflectClass {
 		WKHTMLTOPDF_REFLECT(outline);
 		WKHTMLTOPDF_REFLECT(outlineDepth);
 		WKHTMLTOPDF_REFLECT(dumpOutline);
+		WKHTMLTOPDF_REFLECT(dumpNetworkTimings);
 		WKHTMLTOPDF_REFLECT(out);
 		WKHTMLTOPDF_REFLECT(documentTitle);
 		WKHTMLTOPDF_REFLECT(useCompression);
@@ -383,6 +384,7 @@ PdfGlobal::PdfGlobal():
 	outline(true),
 	outlineDepth(4),
 	dumpOutline(""),
+	dumpNetworkTimings(""),
 	out(""),
 	documentTitle(""),
 	useCompression(true),
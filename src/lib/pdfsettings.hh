@@ -125,6 +125,9 @@ struct DLL_PUBLIC PdfGlobal {
 	//! dump outline to this filename
 	QString dumpOutline;
 
+	//! dump the timing of the requests made to this filename, as a HAR log
+	QString dumpNetworkTimings;
+
 	//! The file where in to store the output
 	QString out;
 
@@ -52,6 +52,10 @@ ReflectClass::~ReflectClass() {
 
 ReflectImpl<LoadGlobal>::ReflectImpl(LoadGlobal & c) {
 	WKHTMLTOPDF_REFLECT(cookieJar);
+	WKHTMLTOPDF_REFLECT(maxParallelPages);
+	WKHTMLTOPDF_REFLECT(shareConnections);
+	WKHTMLTOPDF_REFLECT(memoryCacheSize);
+	WKHTMLTOPDF_REFLECT(shareMemoryCache);
 }
 
 ReflectImpl<LoadPage>::ReflectImpl(LoadPage & c) {
@@ -62,6 +66,8 @@ ReflectImpl<LoadPage>::ReflectImpl(LoadPage & c) {
 	WKHTMLTOPDF_REFLECT(clientSslCrtPath);
 	WKHTMLTOPDF_REFLECT(jsdelay);
 	WKHTMLTOPDF_REFLECT(windowStatus);
+	WKHTMLTOPDF_REFLECT(networkIdle);
+	WKHTMLTOPDF_REFLECT(networkIdleTimeout);
 	WKHTMLTOPDF_REFLECT(zoomFactor);
 	WKHTMLTOPDF_REFLECT(customHeaders);
 	WKHTMLTOPDF_REFLECT(repeatCustomHeaders);
@@ -69,6 +75,7 @@ ReflectImpl<LoadPage>::ReflectImpl(LoadPage & c) {
 	WKHTMLTOPDF_REFLECT(post);
 	WKHTMLTOPDF_REFLECT(blockLocalFileAccess);
 	WKHTMLTOPDF_REFLECT(allowed);
+	WKHTMLTOPDF_REFLECT(requestRules);
 	WKHTMLTOPDF_REFLECT(stopSlowScripts);
 	WKHTMLTOPDF_REFLECT(debugJavascript);
 	WKHTMLTOPDF_REFLECT(loadErrorHandling);
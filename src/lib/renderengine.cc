@@ -19,6 +19,8 @@
 // along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "renderengine.hh"
+#include <QApplication>
+#include <QPointer>
 
 #ifdef WKHTMLTOPDF_USE_WEBENGINE
 #include "renderengine_webengine.hh"
@@ -42,17 +44,225 @@ void ElementInfo::setAttribute(const QString & name, const QString & value) {
 
 // RenderPage factory method
 RenderPage * RenderPage::create(RenderBackend backend, const settings::Web & webSettings) {
+	return create(backend, webSettings, settings::LoadPage());
+}
+
+/*!
+  \brief Create a page whose browser context matches the given load settings
+
+  The page gets a browser context of its own.
+*/
+RenderPage * RenderPage::create(RenderBackend backend, const settings::Web & webSettings,
+                                const settings::LoadPage & loadSettings) {
+	return RenderPagePool::instance()->acquire(backend, webSettings, loadSettings);
+}
+
+/*!
+  \brief Create a page whose browser context matches the given load settings
+
+  Pages created for the same session with equivalent load settings share a
+  browser profile and therefore its caches and cookies. The profile is not
+  handed to another session before every page of this one is released.
+*/
+RenderPage * RenderPage::create(RenderBackend backend, const settings::Web & webSettings,
+                                const settings::LoadPage & loadSettings, const void * session) {
+	return RenderPagePool::instance()->acquire(backend, webSettings, loadSettings, session);
+}
+
+/*!
+  \brief Hand a page obtained from create back to the pool
+*/
+void RenderPage::release(RenderPage * page) {
+	RenderPagePool::instance()->release(page);
+}
+
+// RenderPagePool implementation
+static QPointer<RenderPagePool> s_pagePool;
+
+/*!
+  \brief Get the process wide page pool
+
+  The pool is a child of the application object, it is created before any
+  page or browser profile and is therefore destroyed before them.
+*/
+RenderPagePool * RenderPagePool::instance() {
+	if (s_pagePool.isNull()) s_pagePool = new RenderPagePool();
+	return s_pagePool;
+}
+
+RenderPagePool::RenderPagePool()
+	: QObject(qApp)
+	, m_capacity(4) {
+}
+
+RenderPagePool::~RenderPagePool() {
+	clear();
+}
+
+int RenderPagePool::capacity() const {
+	return m_capacity;
+}
+
+void RenderPagePool::setCapacity(int capacity) {
+	m_capacity = qMax(0, capacity);
+	for (QHash<QString, QList<RenderPage *> >::iterator i=m_idle.begin(); i != m_idle.end(); ++i)
+		while (i.value().size() > m_capacity) {
+			RenderPage * page = i.value().takeLast();
+			m_keys.remove(page);
+			page->deleteLater();
+		}
+}
+
+/*!
+  \brief Lease the browser context a page of session is to use
+  \param context Set to the context, 0 if the backend has none
+  \returns The key of the pages bound to the context
+*/
+QString RenderPagePool::lease(RenderBackend backend, const settings::LoadPage & loadSettings,
+                              const void * session, QObject *& context) {
+	context = nullptr;
+#ifdef WKHTMLTOPDF_USE_WEBENGINE
+	if (backend == RenderBackend::WebEngine) {
+		QWebEngineProfile * profile = WebEngineProfileRegistry::acquire(loadSettings, session);
+		context = profile;
+		return WebEngineProfileRegistry::key(profile);
+	}
+#else
+	Q_UNUSED(loadSettings);
+	Q_UNUSED(session);
+#endif
+	return QString::number(static_cast<int>(backend));
+}
+
+/*!
+  \brief A page no longer uses the context obtained from lease
+*/
+void RenderPagePool::endLease(QObject * context) {
+#ifdef WKHTMLTOPDF_USE_WEBENGINE
+	if (context) WebEngineProfileRegistry::release(static_cast<QWebEngineProfile *>(context));
+#else
+	Q_UNUSED(context);
+#endif
+}
+
+RenderPage * RenderPagePool::createPage(RenderBackend backend, const settings::Web & webSettings,
+                                        QObject * context) {
         if (backend == RenderBackend::WebEngine) {
 #ifdef WKHTMLTOPDF_USE_WEBENGINE
-                return new WebEngineRenderPage(webSettings);
+                return new WebEngineRenderPage(webSettings, static_cast<QWebEngineProfile *>(context));
 #else
+                Q_UNUSED(webSettings);
+                Q_UNUSED(context);
                 return nullptr;
 #endif
         }
         return nullptr;
 }
 
+void RenderPagePool::warm(RenderBackend backend, const settings::Web & webSettings,
+                          const settings::LoadPage & loadSettings, int count) {
+	//The pages are bound to a context nobody uses yet
+	QObject * context;
+	QString k = lease(backend, loadSettings, this, context);
+	for (int i=m_idle.value(k).size(); i < qMin(count, m_capacity); ++i) {
+		RenderPage * page = createPage(backend, webSettings, context);
+		if (!page) break;
+		m_keys[page] = k;
+		connect(page, SIGNAL(destroyed(QObject*)), this, SLOT(pageDestroyed(QObject*)));
+		//Only pages that have finished navigating to about:blank are idle
+		page->reset([this, page, k](bool) {makeIdle(page, k);});
+	}
+	endLease(context);
+}
+
+/*!
+  \brief Lease a page, an idle one if available otherwise a new one
+*/
+RenderPage * RenderPagePool::acquire(RenderBackend backend, const settings::Web & webSettings,
+                                     const settings::LoadPage & loadSettings, const void * session) {
+	QObject * context;
+	QString k = lease(backend, loadSettings, session, context);
+	QList<RenderPage *> & idle = m_idle[k];
+	if (!idle.isEmpty()) {
+		RenderPage * page = idle.takeFirst();
+		page->applySettings(webSettings);
+		m_contexts[page] = context;
+		return page;
+	}
+	RenderPage * page = createPage(backend, webSettings, context);
+	if (!page) {
+		endLease(context);
+		return nullptr;
+	}
+	m_keys[page] = k;
+	m_contexts[page] = context;
+	connect(page, SIGNAL(destroyed(QObject*)), this, SLOT(pageDestroyed(QObject*)));
+	return page;
+}
+
+/*!
+  \brief Return a leased page, it is reset and kept if there is room
+
+  The lease of the browser context only ends once the page has cleared the
+  storage it used and left the document, or once it is destroyed. When every
+  page of a session is back, the state the session left in the browser
+  context is dropped.
+*/
+void RenderPagePool::release(RenderPage * page) {
+	if (!page) return;
+	if (!m_keys.contains(page) || m_idle.value(m_keys[page]).size() >= m_capacity) {
+		//The lease ends in pageDestroyed
+		m_keys.remove(page);
+		page->deleteLater();
+		return;
+	}
+	QString k = m_keys[page];
+	page->reset([this, page, k](bool) {makeIdle(page, k);});
+}
+
+void RenderPagePool::makeIdle(RenderPage * page, const QString & key) {
+	endLease(m_contexts.take(page));
+	QList<RenderPage *> & idle = m_idle[key];
+	if (idle.contains(page)) return;
+	if (idle.size() >= m_capacity) {
+		m_keys.remove(page);
+		page->deleteLater();
+		return;
+	}
+	idle.append(page);
+}
+
+void RenderPagePool::clear() {
+	foreach (const QList<RenderPage *> & idle, m_idle)
+		foreach (RenderPage * page, idle) {
+			m_keys.remove(page);
+			delete page;
+		}
+	m_idle.clear();
+}
+
+void RenderPagePool::pageDestroyed(QObject * page) {
+	RenderPage * p = static_cast<RenderPage *>(page);
+	m_keys.remove(p);
+	endLease(m_contexts.take(p));
+	for (QHash<QString, QList<RenderPage *> >::iterator i=m_idle.begin(); i != m_idle.end(); ++i)
+		i.value().removeAll(p);
+}
+
 // RenderEngineFactory implementation
+/*!
+  \brief Prepare the backends, must be called before the QApplication is created
+
+  The url schemes inline content and the responses of request rules are
+  served under can only be registered then.
+*/
+void RenderEngineFactory::initialize() {
+#ifdef WKHTMLTOPDF_USE_WEBENGINE
+	ContentSchemeHandler::registerScheme();
+	RuleSchemeHandler::registerScheme();
+#endif
+}
+
 RenderBackend RenderEngineFactory::getBestAvailableBackend() {
         // Only WebEngine is supported
         if (isBackendAvailable(RenderBackend::WebEngine)) {
@@ -33,12 +33,16 @@
 #include <functional>
 
 // Forward declarations for Qt classes
+class QIODevice;
 class QPainter;
 class QPrinter;
 class QNetworkAccessManager;
+class QNetworkRequest;
+class QPageLayout;
 
 #include "websettings.hh"
 #include "loadsettings.hh"
+#include "networktiming.hh"
 
 #include <dllbegin.inc>
 
@@ -76,6 +80,17 @@ struct DLL_PUBLIC ElementInfo {
 	int x, y, width, height;
 };
 
+/*!
+ * \brief A heading of a document, as listed in the outline
+ */
+struct DLL_PUBLIC HeadingInfo {
+	// 1 for h1 down to 9 for h9
+	int level;
+	QString text;
+	// Name of the destination the printed document holds for the heading
+	QString anchor;
+};
+
 /*!
  * \brief Callback types for asynchronous operations
  */
@@ -83,6 +98,9 @@ using LoadCallback = std::function<void(bool success)>;
 using ElementCallback = std::function<void(const ElementInfo & element)>;
 using ElementsCallback = std::function<void(const QList<ElementInfo> & elements)>;
 using JavaScriptCallback = std::function<void(const QString & result)>;
+using PdfCallback = std::function<void(const QByteArray & pdf)>;
+using NetworkTimingsCallback = std::function<void(const QList<NetworkTiming> & timings)>;
+using HeadingsCallback = std::function<void(const QList<HeadingInfo> & headings)>;
 
 /*!
  * \brief Abstract interface for a rendered frame
@@ -125,12 +143,32 @@ class DLL_PUBLIC RenderPage : public QObject {
 public:
 	virtual ~RenderPage() {}
 
-	// Factory method to create the appropriate implementation
+	// Factory method to create the appropriate implementation, pages are
+	// leased from the RenderPagePool and must be handed back with release
 	static RenderPage * create(RenderBackend backend, const settings::Web & webSettings);
+	static RenderPage * create(RenderBackend backend, const settings::Web & webSettings,
+	                           const settings::LoadPage & loadSettings);
+	// Pages of the same session share a browser context, no other session sees it
+	static RenderPage * create(RenderBackend backend, const settings::Web & webSettings,
+	                           const settings::LoadPage & loadSettings, const void * session);
+	static void release(RenderPage * page);
+
+	// Drop the handlers, callbacks and signal connections of the current user,
+	// clear the storage of the origin shown and navigate to about:blank. Cookies
+	// and caches of the browser context are dropped by the pool once every page
+	// of the session is back.
+	virtual void reset(LoadCallback callback) = 0;
 
 	// Page loading
 	virtual void load(const QUrl & url, LoadCallback callback) = 0;
 	virtual void setContent(const QString & html, const QUrl & baseUrl, LoadCallback callback) = 0;
+	// Load the html read from device, which must stay around until the page is loaded again.
+	// Returns false if the backend cannot read it, the caller should go through a file then.
+	virtual bool setContent(QIODevice * device, const QUrl & baseUrl, LoadCallback callback) = 0;
+	// Load with the headers of request, a non empty postData turns it into a POST
+	virtual void load(const QNetworkRequest & request, const QByteArray & postData, LoadCallback callback) = 0;
+	// Stop loading and any scheduled refresh
+	virtual void stop() = 0;
 
 	// Page properties
 	virtual QString title() const = 0;
@@ -142,6 +180,8 @@ public:
 
 	// Rendering - PDF
 	virtual void renderToPrinter(QPrinter * printer, std::function<void(bool)> callback) = 0;
+	// Print the page into memory, an empty array signals failure
+	virtual void printToPdf(const QPageLayout & layout, PdfCallback callback) = 0;
 
 	// Rendering - Image
 	virtual QImage renderToImage(const QSize & size) = 0;
@@ -155,6 +195,15 @@ public:
 
 	// Network
 	virtual void setNetworkAccessManager(QNetworkAccessManager * manager) = 0;
+	// Let pending fonts, animation frames and queued tasks settle, then
+	// report through idleChecked if the page is quiet
+	virtual void checkIdle() = 0;
+	// Report the timing of the requests the page made, its url is left empty
+	virtual void networkTimings(NetworkTimingsCallback callback) = 0;
+
+	// Document structure, all headings are collected in a single pass. Each one
+	// gets a named destination, prefix followed by its index, when printed.
+	virtual void headings(const QString & prefix, HeadingsCallback callback) = 0;
 
 	// Callbacks for JavaScript alerts/confirms/prompts
 	virtual void setJavaScriptAlertHandler(std::function<void(const QString &)> handler) = 0;
@@ -166,16 +215,72 @@ signals:
 	void loadProgress(int progress);
 	void loadFinished(bool ok);
 	void printRequested();
+	// A message the page logged to the javascript console
+	void consoleMessage(const QString & message, int lineNumber, const QString & sourceID);
+	// The page assigned a new value to window.status
+	void windowStatusChanged(const QString & status);
+	// The page started or finished a request, pending are still running
+	void networkActivity(int pending);
+	void idleChecked(bool idle);
 
 protected:
 	RenderPage() {}
 };
 
+/*!
+ * \brief Pool of idle, already initialized render pages
+ *
+ * Creating a page spins up a renderer, so pages handed back through
+ * RenderPage::release are reset and kept around for the next lease
+ * with a compatible browser profile.
+ */
+class DLL_PUBLIC RenderPagePool : public QObject {
+	Q_OBJECT
+public:
+	static RenderPagePool * instance();
+
+	// Maximal number of idle pages kept per profile
+	int capacity() const;
+	void setCapacity(int capacity);
+
+	// Create idle pages up front so the first leases are warm as well
+	void warm(RenderBackend backend, const settings::Web & webSettings,
+	          const settings::LoadPage & loadSettings, int count);
+
+	RenderPage * acquire(RenderBackend backend, const settings::Web & webSettings,
+	                     const settings::LoadPage & loadSettings, const void * session = nullptr);
+	void release(RenderPage * page);
+
+	// Destroy all idle pages
+	void clear();
+	virtual ~RenderPagePool();
+
+private slots:
+	void pageDestroyed(QObject * page);
+
+private:
+	RenderPagePool();
+	static QString lease(RenderBackend backend, const settings::LoadPage & loadSettings,
+	                     const void * session, QObject *& context);
+	static void endLease(QObject * context);
+	RenderPage * createPage(RenderBackend backend, const settings::Web & webSettings, QObject * context);
+	void makeIdle(RenderPage * page, const QString & key);
+
+	int m_capacity;
+	QHash<QString, QList<RenderPage *> > m_idle;
+	QHash<RenderPage *, QString> m_keys;
+	//Browser context leased by every page in use
+	QHash<RenderPage *, QObject *> m_contexts;
+};
+
 /*!
  * \brief Factory class for creating rendering backends
  */
 class DLL_PUBLIC RenderEngineFactory {
 public:
+	// Register what the backends need before the application object is created
+	static void initialize();
+
 	// Get the default backend (can be configured at build time or runtime)
 	static RenderBackend defaultBackend();
 
@@ -21,8 +21,26 @@
 #ifdef WKHTMLTOPDF_USE_WEBENGINE
 
 #include "renderengine_webengine.hh"
-#include <QTemporaryFile>
+#include <QFile>
+#include <QNetworkRequest>
+#include <QPageLayout>
+#include <QWebEngineCookieStore>
+#include <QWebEngineHttpRequest>
+#include <QWebEngineScript>
+#include <QWebEngineScriptCollection>
+#include <QWebEngineUrlRequestInfo>
+#include <QWebEngineUrlRequestJob>
+#include <QWebEngineUrlScheme>
 #include <QBuffer>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMimeDatabase>
+#include <QUuid>
+#include <QApplication>
+#include <QStringList>
 
 #include <dllbegin.inc>
 using namespace wkhtmltopdf;
@@ -149,8 +167,350 @@ void WebEngineRenderFrame::findFirstElement(const QString & selector, ElementCal
 	});
 }
 
+// ==================== WebEngineProfileRegistry ====================
+
+QHash<QString, QList<QPointer<QWebEngineProfile> > > WebEngineProfileRegistry::profiles;
+QHash<QWebEngineProfile *, QString> WebEngineProfileRegistry::keys;
+QHash<QWebEngineProfile *, WebEngineProfileRegistry::Lease> WebEngineProfileRegistry::leases;
+
+/*!
+  \brief Build the key used to decide if two pages may share a profile
+
+  The HTTP cache location, the credentials Chromium caches for http auth
+  and the client certificate all live in the browser context, so pages that
+  differ in any of these must not share one.
+*/
+QString WebEngineProfileRegistry::key(const settings::LoadPage & settings) {
+	QStringList parts;
+	parts << settings.cacheDir
+		  << settings.username << settings.password
+		  << settings.clientSslKeyPath << settings.clientSslKeyPassword
+		  << settings.clientSslCrtPath;
+	//The request rules are applied by an interceptor installed on the profile
+	if (!settings.requestRules.isEmpty())
+		parts << settings.requestRules
+			  << QFileInfo(settings.requestRules).lastModified().toString(Qt::ISODate);
+	return parts.join(QChar('\n'));
+}
+
+QString WebEngineProfileRegistry::key(QWebEngineProfile * profile) {
+	return keys.value(profile) + QChar('\n') + QString::number(quintptr(profile), 16);
+}
+
+/*!
+  \brief Get the profile for a page of session loaded with the given settings
+
+  The profile session already uses is shared, otherwise one no session uses
+  is taken. Profiles are created when all are in use and live until the
+  application object is destroyed.
+*/
+QWebEngineProfile * WebEngineProfileRegistry::acquire(const settings::LoadPage & settings, const void * session) {
+	QString k = key(settings);
+	QList<QPointer<QWebEngineProfile> > & list = profiles[k];
+	QWebEngineProfile * unused = nullptr;
+	foreach (const QPointer<QWebEngineProfile> & p, list) {
+		if (p.isNull()) continue;
+		QHash<QWebEngineProfile *, Lease>::iterator i = leases.find(p);
+		if (i == leases.end()) {
+			if (!unused) unused = p;
+		} else if (session && i->session == session) {
+			++i->pages;
+			return p;
+		}
+	}
+	if (!unused) {
+		unused = create(settings, list.size());
+		list.append(unused);
+		keys[unused] = k;
+	}
+	Lease lease = {session, 1};
+	leases[unused] = lease;
+	return unused;
+}
+
+/*!
+  \brief A page of the profile is no longer used, after the last the profile is scrubbed
+*/
+void WebEngineProfileRegistry::release(QWebEngineProfile * profile) {
+	QHash<QWebEngineProfile *, Lease>::iterator i = leases.find(profile);
+	if (i == leases.end() || --i->pages > 0) return;
+	leases.erase(i);
+	scrub(profile);
+}
+
+/*!
+  \brief Delete the state a session left in a profile
+
+  The HTTP cache is kept, warm caches are what sharing a profile is for.
+  Storage of the origins the pages were showing is cleared by the pages
+  themselves, see WebEngineRenderPage::reset.
+*/
+void WebEngineProfileRegistry::scrub(QWebEngineProfile * profile) {
+	profile->cookieStore()->deleteAllCookies();
+	profile->clearAllVisitedLinks();
+}
+
+/*!
+  \brief Create a profile for pages loaded with the given settings
+  \param index The number of profiles created for the settings before
+*/
+QWebEngineProfile * WebEngineProfileRegistry::create(const settings::LoadPage & settings, int index) {
+	QWebEngineProfile * p;
+	if (settings.cacheDir.isEmpty())
+		//Off the record profiles keep their http cache in memory
+		p = new QWebEngineProfile(qApp);
+	else {
+		//Browser contexts must not share a directory, sessions running at
+		//the same time get one of their own below the cache directory
+		QString dir = settings.cacheDir;
+		if (index > 0) dir = QDir(dir).filePath(QString("session-%1").arg(index));
+		p = new QWebEngineProfile(
+			QString("wkhtmltopdf-%1-%2").arg(qHash(key(settings)), 0, 16).arg(index), qApp);
+		p->setCachePath(dir);
+		p->setPersistentStoragePath(dir);
+		p->setHttpCacheType(QWebEngineProfile::DiskHttpCache);
+		p->setPersistentCookiesPolicy(QWebEngineProfile::NoPersistentCookies);
+	}
+	if (ContentSchemeHandler::isRegistered())
+		p->installUrlSchemeHandler(ContentSchemeHandler::scheme, ContentSchemeHandler::instance());
+	if (!settings.requestRules.isEmpty()) {
+		QSharedPointer<RequestRules> rules = RequestRules::load(settings.requestRules, 0);
+		if (rules)
+			p->setUrlRequestInterceptor(new RequestRulesInterceptor(rules, p));
+		if (RuleSchemeHandler::isRegistered())
+			p->installUrlSchemeHandler(RuleSchemeHandler::scheme, RuleSchemeHandler::instance());
+	}
+	return p;
+}
+
+// ==================== RequestRulesInterceptor ====================
+
+RequestRulesInterceptor::RequestRulesInterceptor(QSharedPointer<RequestRules> rules, QObject * parent)
+	: QWebEngineUrlRequestInterceptor(parent), m_rules(rules) {}
+
+void RequestRulesInterceptor::interceptRequest(QWebEngineUrlRequestInfo & info) {
+	if (info.requestUrl().scheme() == RuleSchemeHandler::scheme) return;
+	const RequestRules::Rule * rule = m_rules->match(info.requestUrl());
+	if (!rule) return;
+
+	if (rule->action == RequestRules::rewrite && !RuleSchemeHandler::isRegistered())
+		//Only works for pages that may load local files
+		info.redirect(QUrl::fromLocalFile(rule->argument));
+	else if (rule->action == RequestRules::block || !RuleSchemeHandler::isRegistered())
+		info.block(true);
+	else
+		info.redirect(RuleSchemeHandler::url(*m_rules, rule));
+}
+
+// ==================== RequestCounter ====================
+
+RequestCounter::RequestCounter(QObject * parent)
+	: QWebEngineUrlRequestInterceptor(parent) {}
+
+/*!
+  \brief Report the requests whose completion the network script can see
+
+  Those are the ones that end up as resource timing entries or fail with an
+  error event. Favicons, pings, prefetches, workers and media streams never
+  finish from the point of view of the page, they are left out.
+*/
+void RequestCounter::interceptRequest(QWebEngineUrlRequestInfo & info) {
+	switch (info.resourceType()) {
+	case QWebEngineUrlRequestInfo::ResourceTypeSubFrame:
+	case QWebEngineUrlRequestInfo::ResourceTypeStylesheet:
+	case QWebEngineUrlRequestInfo::ResourceTypeScript:
+	case QWebEngineUrlRequestInfo::ResourceTypeImage:
+	case QWebEngineUrlRequestInfo::ResourceTypeFontResource:
+	case QWebEngineUrlRequestInfo::ResourceTypeObject:
+		emit requestStarted(key(info.requestUrl()), true);
+		break;
+	case QWebEngineUrlRequestInfo::ResourceTypeSubResource:
+	case QWebEngineUrlRequestInfo::ResourceTypeXhr:
+		emit requestStarted(key(info.requestUrl()), false);
+		break;
+	default:
+		break;
+	}
+}
+
+/*!
+  \brief The form urls are compared in, as Chromium and the page serialize them differently
+*/
+QString RequestCounter::key(const QUrl & url) {
+	return url.adjusted(QUrl::RemoveFragment).toString(QUrl::FullyEncoded);
+}
+
+// ==================== RuleSchemeHandler ====================
+
+const QByteArray RuleSchemeHandler::scheme = "wkhtmltopdf-rule";
+bool RuleSchemeHandler::registered = false;
+
+/*!
+  \brief Register the scheme with WebEngine, must happen before the QApplication is created
+
+  Responses are served to pages of any origin, secure ones included, and
+  may be fonts, which are loaded with CORS.
+*/
+void RuleSchemeHandler::registerScheme() {
+	if (registered || qApp) return;
+	QWebEngineUrlScheme s(scheme);
+	s.setSyntax(QWebEngineUrlScheme::Syntax::Host);
+	s.setFlags(QWebEngineUrlScheme::SecureScheme | QWebEngineUrlScheme::CorsEnabled);
+	QWebEngineUrlScheme::registerScheme(s);
+	registered = true;
+}
+
+bool RuleSchemeHandler::isRegistered() {
+	return registered;
+}
+
+RuleSchemeHandler * RuleSchemeHandler::instance() {
+	static QPointer<RuleSchemeHandler> handler;
+	if (handler.isNull()) handler = new RuleSchemeHandler(qApp);
+	return handler;
+}
+
+RuleSchemeHandler::RuleSchemeHandler(QObject * parent): QWebEngineUrlSchemeHandler(parent) {}
+
+/*!
+  \brief Get the url the response of a rule is served under
+*/
+QUrl RuleSchemeHandler::url(const RequestRules & rules, const RequestRules::Rule * rule) {
+	QUrl u;
+	u.setScheme(scheme);
+	//A numeric host would be taken for an ip address
+	u.setHost(QString("rules%1").arg(rules.id()));
+	u.setPath(QString("/%1").arg(rules.indexOf(rule)));
+	return u;
+}
+
+void RuleSchemeHandler::requestStarted(QWebEngineUrlRequestJob * job) {
+	QUrl u = job->requestUrl();
+	QSharedPointer<RequestRules> rules = RequestRules::byId(u.host().mid(5).toInt());
+	const RequestRules::Rule * rule = rules ? rules->rule(u.path().mid(1).toInt()) : 0;
+	if (!rule || rule->action == RequestRules::block) {
+		job->fail(QWebEngineUrlRequestJob::UrlNotFound);
+		return;
+	}
+
+	QIODevice * device;
+	QByteArray mimeType;
+	if (rule->action == RequestRules::rewrite) {
+		QFile * file = new QFile(rule->argument);
+		if (!file->open(QIODevice::ReadOnly)) {
+			delete file;
+			job->fail(QWebEngineUrlRequestJob::UrlNotFound);
+			return;
+		}
+		mimeType = QMimeDatabase().mimeTypeForFile(rule->argument).name().toLatin1();
+		device = file;
+	} else {
+		QBuffer * buffer = new QBuffer();
+		buffer->open(QIODevice::ReadOnly);
+		mimeType = rule->argument.toLatin1();
+		device = buffer;
+	}
+	//The job does not take ownership of the device
+	connect(job, SIGNAL(destroyed()), device, SLOT(deleteLater()));
+	job->reply(mimeType, device);
+}
+
+// ==================== ContentSchemeHandler ====================
+
+const QByteArray ContentSchemeHandler::scheme = "wkhtmltopdf-content";
+bool ContentSchemeHandler::registered = false;
+
+/*!
+  \brief Register the scheme with WebEngine, must happen before the QApplication is created
+
+  The scheme is local with access to local files, so documents may refer to
+  files next to them like a document loaded from a file url.
+*/
+void ContentSchemeHandler::registerScheme() {
+	if (registered || qApp) return;
+	QWebEngineUrlScheme s(scheme);
+	s.setSyntax(QWebEngineUrlScheme::Syntax::Host);
+	s.setFlags(QWebEngineUrlScheme::LocalScheme | QWebEngineUrlScheme::LocalAccessAllowed);
+	QWebEngineUrlScheme::registerScheme(s);
+	registered = true;
+}
+
+bool ContentSchemeHandler::isRegistered() {
+	return registered;
+}
+
+/*!
+  \brief Get the process wide handler, it lives until the application object is destroyed
+*/
+ContentSchemeHandler * ContentSchemeHandler::instance() {
+	static QPointer<ContentSchemeHandler> handler;
+	if (handler.isNull()) handler = new ContentSchemeHandler(qApp);
+	return handler;
+}
+
+ContentSchemeHandler::ContentSchemeHandler(QObject * parent): QWebEngineUrlSchemeHandler(parent) {}
+
+/*!
+  \brief Get the directory part of the path of a base url
+*/
+QString ContentSchemeHandler::documentPath(const QUrl & baseUrl) {
+	QString path = baseUrl.path();
+	return path.left(path.lastIndexOf('/') + 1).prepend(path.startsWith('/') ? "" : "/");
+}
+
+/*!
+  \brief Serve a document read from a device
+  \param device The device to read the document from, it is not owned by the handler
+  \param baseUrl The url relative links in the document resolve against
+  \returns The url to load the document from
+*/
+QUrl ContentSchemeHandler::add(QIODevice * device, const QUrl & baseUrl) {
+	QString host = QUuid::createUuid().toString().remove('{').remove('}');
+	Content & c = contents[host];
+	c.device = device;
+	c.baseUrl = baseUrl;
+	QUrl url;
+	url.setScheme(scheme);
+	url.setHost(host);
+	url.setPath(documentPath(baseUrl));
+	return url;
+}
+
+/*!
+  \brief Stop serving the document registered under url
+*/
+void ContentSchemeHandler::remove(const QUrl & url) {
+	contents.remove(url.host());
+}
+
+void ContentSchemeHandler::requestStarted(QWebEngineUrlRequestJob * job) {
+	QUrl url = job->requestUrl();
+	if (!contents.contains(url.host())) {
+		job->fail(QWebEngineUrlRequestJob::UrlNotFound);
+		return;
+	}
+	const Content & c = contents[url.host()];
+	if (url.path() != documentPath(c.baseUrl)) {
+		QUrl target = c.baseUrl;
+		target.setPath(url.path());
+		target.setQuery(url.query());
+		job->redirect(target);
+		return;
+	}
+	if (c.device.isNull()) {
+		job->fail(QWebEngineUrlRequestJob::RequestFailed);
+		return;
+	}
+	if (!c.device->isSequential()) c.device->seek(0);
+	job->reply("text/html", c.device);
+}
+
 // ==================== CustomWebEnginePage ====================
 
+const QString CustomWebEnginePage::windowStatusPrefix = "wkhtmltopdf-window-status:";
+const QString CustomWebEnginePage::networkPrefix = "wkhtmltopdf-network:";
+const QString CustomWebEnginePage::idlePrefix = "wkhtmltopdf-idle:";
+
 CustomWebEnginePage::CustomWebEnginePage(QWebEngineProfile * profile, QObject * parent)
 	: QWebEnginePage(profile, parent) {
 }
@@ -195,14 +555,27 @@ bool CustomWebEnginePage::javaScriptPrompt(const QUrl & securityOrigin, const QS
 	}
 }
 
+void CustomWebEnginePage::javaScriptConsoleMessage(JavaScriptConsoleMessageLevel level, const QString & message,
+                                                   int lineNumber, const QString & sourceID) {
+	Q_UNUSED(level);
+	if (message.startsWith(windowStatusPrefix))
+		emit windowStatusChanged(message.mid(windowStatusPrefix.size()));
+	else if (message.startsWith(networkPrefix))
+		emit requestFinished(message.mid(networkPrefix.size()));
+	else if (message.startsWith(idlePrefix))
+		emit idleChecked(message.mid(idlePrefix.size()).toInt() == 0);
+	else
+		emit consoleMessage(message, lineNumber, sourceID);
+}
+
 // ==================== WebEngineRenderPage ====================
 
-WebEngineRenderPage::WebEngineRenderPage(const settings::Web & webSettings)
-	: m_profile(new QWebEngineProfile())
+WebEngineRenderPage::WebEngineRenderPage(const settings::Web & webSettings, QWebEngineProfile * profile)
+	: m_profile(profile)
 	, m_page(nullptr)
 	, m_mainFrame(nullptr)
 	, m_loadCallback(nullptr)
-	, m_printCallback(nullptr)
+	, m_generation(0)
 	, m_viewportSize(1024, 768) {
 
 	// Create custom page
@@ -212,7 +585,98 @@ WebEngineRenderPage::WebEngineRenderPage(const settings::Web & webSettings)
 	connect(m_page, &QWebEnginePage::loadStarted, this, &WebEngineRenderPage::onLoadStarted);
 	connect(m_page, &QWebEnginePage::loadProgress, this, &WebEngineRenderPage::onLoadProgress);
 	connect(m_page, &QWebEnginePage::loadFinished, this, &WebEngineRenderPage::onLoadFinished);
-	connect(m_page, &QWebEnginePage::pdfPrintingFinished, this, &WebEngineRenderPage::onPrintingFinished);
+	connect(m_page, &QWebEnginePage::printRequested, this, &RenderPage::printRequested);
+	connect(m_page, &CustomWebEnginePage::consoleMessage, this, &RenderPage::consoleMessage);
+	connect(m_page, &CustomWebEnginePage::windowStatusChanged, this, &RenderPage::windowStatusChanged);
+	connect(m_page, &CustomWebEnginePage::requestFinished, this, &WebEngineRenderPage::requestFinished);
+	connect(m_page, &CustomWebEnginePage::idleChecked, this, &WebEngineRenderPage::onIdleChecked);
+
+	// Requests are counted as they start, whatever started them, and the
+	// network script below reports them as they finish
+#if QT_VERSION >= 0x050D00
+	RequestCounter * counter = new RequestCounter(this);
+	connect(counter, &RequestCounter::requestStarted, this, &WebEngineRenderPage::requestStarted);
+	m_page->setUrlRequestInterceptor(counter);
+#endif
+
+	// Report every assignment to window.status as it happens, the page
+	// cannot be read synchronously from here like a QWebFrame could
+	QWebEngineScript windowStatus;
+	windowStatus.setName("wkhtmltopdf-window-status");
+	windowStatus.setInjectionPoint(QWebEngineScript::DocumentCreation);
+	windowStatus.setWorldId(QWebEngineScript::MainWorld);
+	windowStatus.setRunsOnSubFrames(false);
+	windowStatus.setSourceCode(QString(
+		"(function() {"
+		"  var status = '';"
+		"  Object.defineProperty(window, 'status', {"
+		"    configurable: true,"
+		"    get: function() { return status; },"
+		"    set: function(value) {"
+		"      status = String(value);"
+		"      console.debug('%1' + status);"
+		"    }"
+		"  });"
+		"})();").arg(CustomWebEnginePage::windowStatusPrefix));
+	m_page->scripts().insert(windowStatus);
+
+	// Report every request that finishes, in the document and its frames:
+	// the resource timing entries, and the fetch, XMLHttpRequest and element
+	// loads that fail without one. The timing of every resource is kept for
+	// networkTimings. Chromium does the networking, so there is no
+	// QNetworkAccessManager to watch.
+	QWebEngineScript network;
+	network.setName("wkhtmltopdf-network");
+	network.setInjectionPoint(QWebEngineScript::DocumentCreation);
+	network.setWorldId(QWebEngineScript::MainWorld);
+	network.setRunsOnSubFrames(true);
+	network.setSourceCode(QString(
+		"(function() {"
+		"  function done(url) {"
+		"    try { console.debug('%1' + new URL(url, document.baseURI).href); } catch (e) {}"
+		"  }"
+		"  var fetch = window.fetch;"
+		"  if (fetch) window.fetch = function(input) {"
+		"    var url = input instanceof Request ? input.url : String(input);"
+		"    return fetch.apply(this, arguments).catch(function(e) { done(url); throw e; });"
+		"  };"
+		"  var open = XMLHttpRequest.prototype.open;"
+		"  XMLHttpRequest.prototype.open = function(method, url) {"
+		"    this.__wkhtmltopdfUrl = String(url);"
+		"    return open.apply(this, arguments);"
+		"  };"
+		"  var send = XMLHttpRequest.prototype.send;"
+		"  XMLHttpRequest.prototype.send = function() {"
+		"    this.addEventListener('loadend', function() {"
+		"      if (this.status == 0) done(this.__wkhtmltopdfUrl);"
+		"    });"
+		"    return send.apply(this, arguments);"
+		"  };"
+		"  window.addEventListener('error', function(e) {"
+		"    var t = e.target;"
+		"    if (t && t != window) done(t.currentSrc || t.src || t.href);"
+		"  }, true);"
+		"  try {"
+		"    new PerformanceObserver(function(list) {"
+		"      list.getEntries().forEach(function(e) { done(e.name); });"
+		"    }).observe({entryTypes: ['resource']});"
+		"    performance.setResourceTimingBufferSize(100000);"
+		"  } catch (e) {}"
+		"  window.__wkhtmltopdfCheckIdle = function() {"
+		"    var checked = false;"
+		"    function check() {"
+		"      if (checked) return;"
+		"      checked = true;"
+		"      setTimeout(function() {"
+		"        var busy = document.fonts && document.fonts.status != 'loaded' ? 1 : 0;"
+		"        console.debug('%2' + busy);"
+		"      }, 0);"
+		"    }"
+		"    requestAnimationFrame(check);"
+		"    setTimeout(check, 100);"
+		"  };"
+		"})();").arg(CustomWebEnginePage::networkPrefix, CustomWebEnginePage::idlePrefix));
+	m_page->scripts().insert(network);
 
 	// Create main frame wrapper
 	m_mainFrame = new WebEngineRenderFrame(m_page);
@@ -222,21 +686,70 @@ WebEngineRenderPage::WebEngineRenderPage(const settings::Web & webSettings)
 }
 
 WebEngineRenderPage::~WebEngineRenderPage() {
+	forgetContent();
 	delete m_mainFrame;
+	//The profile is shared, see WebEngineProfileRegistry
 	delete m_page;
-	delete m_profile;
 }
 
 void WebEngineRenderPage::load(const QUrl & url, LoadCallback callback) {
+	forgetContent();
 	m_loadCallback = callback;
 	m_page->load(url);
 }
 
+void WebEngineRenderPage::load(const QNetworkRequest & request, const QByteArray & postData, LoadCallback callback) {
+	forgetContent();
+	m_loadCallback = callback;
+	QWebEngineHttpRequest r(request.url(),
+	                        postData.isEmpty() ? QWebEngineHttpRequest::Get : QWebEngineHttpRequest::Post);
+	foreach (const QByteArray & name, request.rawHeaderList())
+		r.setHeader(name, request.rawHeader(name));
+	if (!postData.isEmpty())
+		r.setPostData(postData);
+	m_page->load(r);
+}
+
+void WebEngineRenderPage::stop() {
+	if (m_page) m_page->triggerAction(QWebEnginePage::Stop);
+}
+
 void WebEngineRenderPage::setContent(const QString & html, const QUrl & baseUrl, LoadCallback callback) {
+	forgetContent();
 	m_loadCallback = callback;
 	m_page->setHtml(html, baseUrl);
 }
 
+/*!
+  \brief Load a document from a device
+
+  The document is read by the page as it needs it, through the
+  ContentSchemeHandler. Without the scheme only documents small enough for
+  setHtml can be loaded.
+*/
+bool WebEngineRenderPage::setContent(QIODevice * device, const QUrl & baseUrl, LoadCallback callback) {
+	if (!ContentSchemeHandler::isRegistered()) {
+		//setHtml percent encodes the document into a data url of at most 2MB
+		if (device->isSequential() || device->size() > 512 * 1024) return false;
+		setContent(QString::fromUtf8(device->readAll()), baseUrl, callback);
+		return true;
+	}
+	forgetContent();
+	m_loadCallback = callback;
+	m_contentUrl = ContentSchemeHandler::instance()->add(device, baseUrl);
+	m_page->load(m_contentUrl);
+	return true;
+}
+
+/*!
+  \brief Stop serving the document passed to setContent, if any
+*/
+void WebEngineRenderPage::forgetContent() {
+	if (m_contentUrl.isEmpty()) return;
+	ContentSchemeHandler::instance()->remove(m_contentUrl);
+	m_contentUrl = QUrl();
+}
+
 QString WebEngineRenderPage::title() const {
 	return m_page ? m_page->title() : QString();
 }
@@ -277,24 +790,38 @@ void WebEngineRenderPage::renderToPrinter(QPrinter * printer, std::function<void
 		return;
 	}
 
-	m_printCallback = callback;
+	// Chromium produces the finished PDF, all that is left for us is to
+	// store it where the printer would have put it
+	QString path = printer->outputFileName();
+	printToPdf(printer->pageLayout(), [path, callback](const QByteArray & pdf) {
+		bool ok = !pdf.isEmpty();
+		if (ok && !path.isEmpty()) {
+			QFile file(path);
+			ok = file.open(QIODevice::WriteOnly) && file.write(pdf) == pdf.size();
+		}
+		if (callback) callback(ok);
+	});
+}
+
+/*!
+  \brief Print the page straight into memory
 
-	// WebEngine uses printToPdf which is asynchronous and outputs to a file
-	// We need to create a temporary file and then convert to QPrinter
-	QTemporaryFile tempFile;
-	if (!tempFile.open()) {
-		if (callback) callback(false);
+  This uses the callback form of QWebEnginePage::printToPdf, so the document
+  never touches the filesystem.
+*/
+void WebEngineRenderPage::printToPdf(const QPageLayout & layout, PdfCallback callback) {
+	if (!m_page) {
+		if (callback) callback(QByteArray());
 		return;
 	}
 
-	QString tempPath = tempFile.fileName();
-	tempFile.close();
-
-	// Set up page layout to match printer settings
-	QPageLayout layout = printer->pageLayout();
-	m_page->printToPdf(tempPath, layout);
-
-	// Result will be handled in onPrintingFinished slot
+	//The page may be released and leased again before Chromium is done
+	QPointer<WebEngineRenderPage> self(this);
+	quint64 generation = m_generation;
+	m_page->printToPdf([self, generation, callback](const QByteArray & pdf) {
+		if (!self || self->m_generation != generation) return;
+		if (callback) callback(pdf);
+	}, layout);
 }
 
 QImage WebEngineRenderPage::renderToImage(const QSize & size) {
@@ -350,8 +877,173 @@ void WebEngineRenderPage::setJavaScriptPromptHandler(std::function<bool(const QS
 	}
 }
 
+void WebEngineRenderPage::reset(LoadCallback callback) {
+	//Drop every connection made by the previous user of the page, the
+	//destroyed signal is left alone as the pool tracks it
+	disconnect(this, SIGNAL(loadStarted()), nullptr, nullptr);
+	disconnect(this, SIGNAL(loadProgress(int)), nullptr, nullptr);
+	disconnect(this, SIGNAL(loadFinished(bool)), nullptr, nullptr);
+	disconnect(this, SIGNAL(printRequested()), nullptr, nullptr);
+	disconnect(this, SIGNAL(consoleMessage(const QString &, int, const QString &)), nullptr, nullptr);
+	disconnect(this, SIGNAL(windowStatusChanged(const QString &)), nullptr, nullptr);
+	disconnect(this, SIGNAL(networkActivity(int)), nullptr, nullptr);
+	disconnect(this, SIGNAL(idleChecked(bool)), nullptr, nullptr);
+	++m_generation;
+	forgetRequests();
+	m_page->setJavaScriptAlertHandler(nullptr);
+	m_page->setJavaScriptConfirmHandler(nullptr);
+	m_page->setJavaScriptPromptHandler(nullptr);
+	m_viewportSize = QSize(1024, 768);
+	m_page->triggerAction(QWebEnginePage::Stop);
+	//Storage is kept by origin, clear what the origin shown has stored. The
+	//script runs in its own world, so it works with javascript disabled.
+	QPointer<WebEngineRenderPage> self(this);
+	m_page->runJavaScript(
+		"(function() {"
+		"  try { localStorage.clear(); sessionStorage.clear(); } catch (e) {}"
+		"  try {"
+		"    if (window.indexedDB && indexedDB.databases) indexedDB.databases().then(function(l) {"
+		"      l.forEach(function(d) { indexedDB.deleteDatabase(d.name); }); });"
+		"    if (window.caches) caches.keys().then(function(l) {"
+		"      l.forEach(function(k) { caches.delete(k); }); });"
+		"    if (navigator.serviceWorker) navigator.serviceWorker.getRegistrations().then(function(l) {"
+		"      l.forEach(function(r) { r.unregister(); }); });"
+		"  } catch (e) {}"
+		"})()",
+		QWebEngineScript::ApplicationWorld,
+		[self, callback](const QVariant &) {
+			if (self) self->load(QUrl("about:blank"), callback);
+		});
+}
+
+/*!
+ * Wait for an animation frame, a hidden page may not get one so give up
+ * on it after 100ms, and a turn of the task queue. Then report whether
+ * fonts are still loading, see onIdleChecked.
+ */
+void WebEngineRenderPage::checkIdle() {
+	m_page->runJavaScript(
+		"if (window.__wkhtmltopdfCheckIdle) window.__wkhtmltopdfCheckIdle();"
+		"else console.debug('" + CustomWebEnginePage::idlePrefix + "0');");
+}
+
+/*!
+  \brief Read the resource timing entries of the document and its resources
+
+  Responses from other origins without a Timing-Allow-Origin header only
+  tell when they started and ended, all of it is reported as receive time.
+*/
+void WebEngineRenderPage::networkTimings(NetworkTimingsCallback callback) {
+	m_page->runJavaScript(
+		"(function() {"
+		"  if (!window.performance || !performance.getEntriesByType) return [];"
+		"  var origin = performance.timeOrigin || performance.timing.navigationStart;"
+		"  function span(from, to) { return from > 0 && to >= from ? to - from : -1; }"
+		"  return performance.getEntriesByType('navigation')"
+		"    .concat(performance.getEntriesByType('resource')).map(function(e) {"
+		"      var detailed = e.requestStart > 0;"
+		"      return {"
+		"        url: e.name,"
+		"        started: origin + e.startTime,"
+		"        status: e.responseStatus || 0,"
+		"        dns: detailed ? span(e.domainLookupStart, e.domainLookupEnd) : -1,"
+		"        connect: detailed ? span(e.connectStart, e.connectEnd) : -1,"
+		"        ssl: detailed ? span(e.secureConnectionStart, e.connectEnd) : -1,"
+		"        wait: detailed ? span(e.requestStart, e.responseStart) : -1,"
+		"        receive: detailed ? span(e.responseStart, e.responseEnd) : e.duration,"
+		"        bytes: e.transferSize || e.encodedBodySize || 0"
+		"      };"
+		"    });"
+		"})()",
+		[callback](const QVariant & result) {
+			QList<NetworkTiming> timings;
+			foreach (const QVariant & entry, result.toList()) {
+				QVariantMap e = entry.toMap();
+				NetworkTiming t;
+				t.url = e.value("url").toString();
+				t.started = QDateTime::fromMSecsSinceEpoch(qint64(e.value("started").toDouble()));
+				t.status = e.value("status").toInt();
+				t.dns = e.value("dns").toDouble();
+				t.connect = e.value("connect").toDouble();
+				t.ssl = e.value("ssl").toDouble();
+				t.wait = e.value("wait").toDouble();
+				t.receive = e.value("receive").toDouble();
+				t.bytes = qint64(e.value("bytes").toDouble());
+				timings.append(t);
+			}
+			if (callback) callback(timings);
+		});
+}
+
+/*!
+  \brief Collect the h1 to h9 elements of the document in document order
+
+  The whole document is walked by one script that returns a single JSON
+  string, so the cost of a round trip to the renderer does not grow with the
+  number of headings.
+
+  Where a heading is printed is only known to the renderer. Every heading is
+  therefore made the target of a hidden link, and Chromium writes a named
+  destination for each link target at the place it printed it. A heading
+  without an id gets the name as its id, otherwise an empty anchor carrying
+  the name is put at its start.
+  \param prefix The start of the names, the index of the heading is appended
+*/
+void WebEngineRenderPage::headings(const QString & prefix, HeadingsCallback callback) {
+	QPointer<WebEngineRenderPage> self(this);
+	quint64 generation = m_generation;
+	m_page->runJavaScript(QString(
+		"(function() {"
+		"  var list = document.querySelectorAll('h1,h2,h3,h4,h5,h6,h7,h8,h9');"
+		"  var links = document.head || document.documentElement;"
+		"  var res = [];"
+		"  for (var i = 0; i < list.length; ++i) {"
+		"    var text = list[i].textContent.replace(/\\s+/g, ' ').trim();"
+		"    if (!text) continue;"
+		"    var name = '%1' + res.length;"
+		"    if (!list[i].id) list[i].id = name;"
+		"    else {"
+		"      var anchor = document.createElement('a');"
+		"      anchor.name = name;"
+		"      anchor.style.position = 'absolute';"
+		"      list[i].insertBefore(anchor, list[i].firstChild);"
+		"    }"
+		"    var link = document.createElement('a');"
+		"    link.href = '#' + name;"
+		"    link.style.display = 'none';"
+		"    links.appendChild(link);"
+		"    res.push([+list[i].tagName.charAt(1), text, name]);"
+		"  }"
+		"  return JSON.stringify(res);"
+		"})()").arg(prefix),
+		[self, generation, callback](const QVariant & result) {
+			if (!self || self->m_generation != generation) return;
+			QList<HeadingInfo> headings;
+			foreach (const QJsonValue & entry, QJsonDocument::fromJson(result.toString().toUtf8()).array()) {
+				QJsonArray e = entry.toArray();
+				if (e.size() != 3) continue;
+				HeadingInfo h;
+				h.level = e[0].toInt();
+				h.text = e[1].toString();
+				h.anchor = e[2].toString();
+				headings.append(h);
+			}
+			if (callback) callback(headings);
+		});
+}
+
+/*!
+  \brief Stop waiting for the requests of the document shown before
+*/
+void WebEngineRenderPage::forgetRequests() {
+	if (m_requests.isEmpty()) return;
+	m_requests.clear();
+	emit networkActivity(0);
+}
+
 // Slots
 void WebEngineRenderPage::onLoadStarted() {
+	forgetRequests();
 	emit loadStarted();
 }
 
@@ -360,21 +1052,46 @@ void WebEngineRenderPage::onLoadProgress(int progress) {
 }
 
 void WebEngineRenderPage::onLoadFinished(bool ok) {
+	//The load waited for these, whether they succeeded or not
+	int pending = m_requests.size();
+	for (QList<Request>::iterator i=m_requests.begin(); i != m_requests.end();) {
+		if (i->untilLoad) i = m_requests.erase(i);
+		else ++i;
+	}
+	if (m_requests.size() != pending) emit networkActivity(m_requests.size());
 	emit loadFinished(ok);
 
-	if (m_loadCallback) {
-		m_loadCallback(ok);
-		m_loadCallback = nullptr;
-	}
+	//The callback may well start the next load
+	LoadCallback callback = m_loadCallback;
+	m_loadCallback = nullptr;
+	if (callback) callback(ok);
+}
+
+/*!
+  \brief The page is quiet once fonts are loaded and no request is left running
+*/
+void WebEngineRenderPage::onIdleChecked(bool idle) {
+	emit idleChecked(idle && m_requests.isEmpty());
+}
+
+void WebEngineRenderPage::requestStarted(const QString & url, bool untilLoad) {
+	Request r;
+	r.url = url;
+	r.untilLoad = untilLoad;
+	m_requests.append(r);
+	emit networkActivity(m_requests.size());
 }
 
-void WebEngineRenderPage::onPrintingFinished(const QString & filePath, bool success) {
-	// PDF has been saved to file
-	// If we needed to output to QPrinter, we would need to read the file
-	// and write it to the printer's output stream
-	if (m_printCallback) {
-		m_printCallback(success);
-		m_printCallback = nullptr;
+/*!
+  \brief A request finished, those the page made before it was shown are ignored
+*/
+void WebEngineRenderPage::requestFinished(const QString & url) {
+	QString k = RequestCounter::key(QUrl(url));
+	for (int i=0; i < m_requests.size(); ++i) {
+		if (m_requests[i].url != k) continue;
+		m_requests.removeAt(i);
+		emit networkActivity(m_requests.size());
+		return;
 	}
 }
 
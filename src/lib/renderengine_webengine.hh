@@ -24,13 +24,20 @@
 #ifdef WKHTMLTOPDF_USE_WEBENGINE
 
 #include "renderengine.hh"
+#include "requestrules.hh"
 
 #include <QWebEnginePage>
 #include <QWebEngineSettings>
 #include <QWebEngineProfile>
+#include <QWebEngineUrlRequestInterceptor>
+#include <QWebEngineUrlSchemeHandler>
+#include <QSharedPointer>
 #include <QPrinter>
 #include <QPainter>
 #include <QEventLoop>
+#include <QHash>
+#include <QList>
+#include <QPointer>
 
 #include <dllbegin.inc>
 
@@ -62,6 +69,133 @@ private:
 	mutable QSize m_contentsSize;
 };
 
+/*!
+ * \brief Process wide registry of shared QWebEngineProfile instances
+ *
+ * Bringing up a QWebEngineProfile creates a new Chromium browser context
+ * with cold HTTP, font and image caches. Pages of one session whose load
+ * settings agree on the fields that influence the browser context share one
+ * profile instead. Web settings are applied per page through
+ * QWebEngineSettings and therefore do not take part in the key.
+ *
+ * A profile is leased to a single session at a time, so cookies and storage
+ * never reach a conversion running alongside. When the last page of the
+ * session is released its cookies and visited links are deleted before the
+ * profile is leased again. The HTTP cache is kept for the next session;
+ * credentials take part in the key, so responses fetched with them are only
+ * served to sessions using the same ones.
+ */
+class DLL_LOCAL WebEngineProfileRegistry {
+public:
+	// Lease a profile for one more page of session, a null session shares with nobody
+	static QWebEngineProfile * acquire(const settings::LoadPage & settings, const void * session);
+	// A page of the profile is no longer used
+	static void release(QWebEngineProfile * profile);
+	static QString key(const settings::LoadPage & settings);
+	// Key of the pages bound to profile
+	static QString key(QWebEngineProfile * profile);
+private:
+	struct Lease {
+		const void * session;
+		int pages;
+	};
+	static QWebEngineProfile * create(const settings::LoadPage & settings, int index);
+	static void scrub(QWebEngineProfile * profile);
+	static QHash<QString, QList<QPointer<QWebEngineProfile> > > profiles;
+	static QHash<QWebEngineProfile *, QString> keys;
+	static QHash<QWebEngineProfile *, Lease> leases;
+};
+
+/*!
+ * \brief Serves documents read from a device under a custom url scheme
+ *
+ * QWebEnginePage::setHtml passes the document through a data url, which
+ * Chromium limits to 2MB, and which has to be encoded first. Documents are
+ * instead registered here and read straight from their device. The path of
+ * a document url mirrors the path of its base url and every other url of
+ * the scheme is redirected to the base url, so relative links resolve as if
+ * the document was at the base url.
+ */
+class DLL_LOCAL ContentSchemeHandler : public QWebEngineUrlSchemeHandler {
+	Q_OBJECT
+public:
+	static const QByteArray scheme;
+	static void registerScheme();
+	static bool isRegistered();
+	static ContentSchemeHandler * instance();
+
+	QUrl add(QIODevice * device, const QUrl & baseUrl);
+	void remove(const QUrl & url);
+	virtual void requestStarted(QWebEngineUrlRequestJob * job) override;
+
+private:
+	struct Content {
+		QPointer<QIODevice> device;
+		QUrl baseUrl;
+	};
+
+	ContentSchemeHandler(QObject * parent);
+	static QString documentPath(const QUrl & baseUrl);
+	static bool registered;
+	//Registered documents, by the host of their url
+	QHash<QString, Content> contents;
+};
+
+/*!
+ * \brief Applies the request rules of a profile to every request its pages make
+ *
+ * Blocked requests fail, rewritten and stubbed out requests are redirected
+ * to the RuleSchemeHandler.
+ */
+class DLL_LOCAL RequestRulesInterceptor : public QWebEngineUrlRequestInterceptor {
+	Q_OBJECT
+public:
+	RequestRulesInterceptor(QSharedPointer<RequestRules> rules, QObject * parent);
+	virtual void interceptRequest(QWebEngineUrlRequestInfo & info) override;
+private:
+	QSharedPointer<RequestRules> m_rules;
+};
+
+/*!
+ * \brief Reports the sub-requests a single page starts
+ *
+ * Installed on the page, so it sees every request of the page and its
+ * frames, whatever started it. Their completions are reported by the
+ * network script of WebEngineRenderPage.
+ */
+class DLL_LOCAL RequestCounter : public QWebEngineUrlRequestInterceptor {
+	Q_OBJECT
+public:
+	RequestCounter(QObject * parent);
+	virtual void interceptRequest(QWebEngineUrlRequestInfo & info) override;
+	static QString key(const QUrl & url);
+signals:
+	// untilLoad is set for resources the load of the page waits for
+	void requestStarted(const QString & url, bool untilLoad);
+};
+
+/*!
+ * \brief Serves the responses of rewrite and stub request rules
+ *
+ * Urls of the scheme name a rule by the id of its rules and its index, so
+ * only files that are the target of a rewrite rule can be read through it.
+ */
+class DLL_LOCAL RuleSchemeHandler : public QWebEngineUrlSchemeHandler {
+	Q_OBJECT
+public:
+	static const QByteArray scheme;
+	static void registerScheme();
+	static bool isRegistered();
+	static RuleSchemeHandler * instance();
+	static QUrl url(const RequestRules & rules, const RequestRules::Rule * rule);
+
+	virtual void requestStarted(QWebEngineUrlRequestJob * job) override;
+
+private:
+	RuleSchemeHandler(QObject * parent);
+	static bool registered;
+};
+
 /*!
  * \brief Custom QWebEnginePage subclass to handle JavaScript dialogs
  */
@@ -74,11 +208,24 @@ public:
 	void setJavaScriptConfirmHandler(std::function<bool(const QString &)> handler);
 	void setJavaScriptPromptHandler(std::function<bool(const QString &, const QString &, QString *)> handler);
 
+	// Prefixes of the console messages the injected scripts report through
+	static const QString windowStatusPrefix;
+	static const QString networkPrefix;
+	static const QString idlePrefix;
+
+signals:
+	void consoleMessage(const QString & message, int lineNumber, const QString & sourceID);
+	void windowStatusChanged(const QString & status);
+	void requestFinished(const QString & url);
+	void idleChecked(bool idle);
+
 protected:
 	virtual void javaScriptAlert(const QUrl & securityOrigin, const QString & msg) override;
 	virtual bool javaScriptConfirm(const QUrl & securityOrigin, const QString & msg) override;
 	virtual bool javaScriptPrompt(const QUrl & securityOrigin, const QString & msg,
 	                               const QString & defaultValue, QString * result) override;
+	virtual void javaScriptConsoleMessage(JavaScriptConsoleMessageLevel level, const QString & message,
+	                                      int lineNumber, const QString & sourceID) override;
 
 private:
 	std::function<void(const QString &)> m_jsAlertHandler;
@@ -92,17 +239,21 @@ private:
 class DLL_LOCAL WebEngineRenderPage : public RenderPage {
 	Q_OBJECT
 public:
-	WebEngineRenderPage(const settings::Web & webSettings);
+	WebEngineRenderPage(const settings::Web & webSettings, QWebEngineProfile * profile);
 	virtual ~WebEngineRenderPage();
 
 	// RenderPage interface
 	virtual void load(const QUrl & url, LoadCallback callback) override;
 	virtual void setContent(const QString & html, const QUrl & baseUrl, LoadCallback callback) override;
+	virtual bool setContent(QIODevice * device, const QUrl & baseUrl, LoadCallback callback) override;
+	virtual void load(const QNetworkRequest & request, const QByteArray & postData, LoadCallback callback) override;
+	virtual void stop() override;
 	virtual QString title() const override;
 	virtual QUrl url() const override;
 	virtual RenderFrame * mainFrame() override;
 	virtual void applySettings(const settings::Web & settings) override;
 	virtual void renderToPrinter(QPrinter * printer, std::function<void(bool)> callback) override;
+	virtual void printToPdf(const QPageLayout & layout, PdfCallback callback) override;
 	virtual QImage renderToImage(const QSize & size) override;
 	virtual void setViewportSize(const QSize & size) override;
 	virtual QSize viewportSize() const override;
@@ -111,6 +262,10 @@ public:
 	virtual void setJavaScriptAlertHandler(std::function<void(const QString &)> handler) override;
 	virtual void setJavaScriptConfirmHandler(std::function<bool(const QString &)> handler) override;
 	virtual void setJavaScriptPromptHandler(std::function<bool(const QString &, const QString &, QString *)> handler) override;
+	virtual void reset(LoadCallback callback) override;
+	virtual void checkIdle() override;
+	virtual void networkTimings(NetworkTimingsCallback callback) override;
+	virtual void headings(const QString & prefix, HeadingsCallback callback) override;
 
 	// Get the underlying QWebEnginePage (for debugging/advanced usage)
 	CustomWebEnginePage * webEnginePage() const { return m_page; }
@@ -119,15 +274,30 @@ private slots:
 	void onLoadStarted();
 	void onLoadProgress(int progress);
 	void onLoadFinished(bool ok);
-	void onPrintingFinished(const QString & filePath, bool success);
+	void onIdleChecked(bool idle);
+	void requestStarted(const QString & url, bool untilLoad);
+	void requestFinished(const QString & url);
 
 private:
+	void forgetContent();
+	void forgetRequests();
+
+	struct Request {
+		QString url;
+		bool untilLoad;
+	};
+
 	QWebEngineProfile * m_profile;
 	CustomWebEnginePage * m_page;
 	WebEngineRenderFrame * m_mainFrame;
 	LoadCallback m_loadCallback;
-	std::function<void(bool)> m_printCallback;
+	//Bumped by reset, completions of requests made before are dropped
+	quint64 m_generation;
 	QSize m_viewportSize;
+	//Url the document passed to setContent is served under, see ContentSchemeHandler
+	QUrl m_contentUrl;
+	//Sub-requests started by the document shown and not finished yet
+	QList<Request> m_requests;
 };
 
 }
@@ -0,0 +1,195 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "requestrules.hh"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+/*!
+  \file requestrules.hh
+  \brief Defines the RequestRules class
+*/
+
+QHash<QString, QSharedPointer<RequestRules> > RequestRules::cache;
+int RequestRules::nextId = 1;
+
+RequestRules::RequestRules(): ruleSetId(nextId++) {
+	trie.append(Node());
+}
+
+/*!
+  \brief Get the compiled rules of a file
+
+  Files are compiled once, until they are modified.
+  \param path The path of the rule file
+  \param errors Lines that could not be parsed are appended to this
+  \returns The rules, or a null pointer if the file could not be read
+*/
+QSharedPointer<RequestRules> RequestRules::load(const QString & path, QStringList * errors) {
+	QFileInfo info(path);
+	QString key = info.absoluteFilePath() + '\n' + info.lastModified().toString(Qt::ISODate);
+	if (cache.contains(key)) return cache[key];
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		if (errors) errors->append(QString("Unable to read request rules from %1").arg(path));
+		return QSharedPointer<RequestRules>();
+	}
+
+	QSharedPointer<RequestRules> rules(new RequestRules());
+	QTextStream in(&file);
+	for (int line = 1; !in.atEnd(); ++line) {
+#if QT_VERSION >= 0x050e00
+		QStringList parts = in.readLine().split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+#else
+		QStringList parts = in.readLine().split(QRegularExpression("\\s+"), QString::SkipEmptyParts);
+#endif
+		if (parts.isEmpty() || parts[0].startsWith('#')) continue;
+
+		Rule rule;
+		int arguments = parts.size() - 2;
+		bool ok = arguments >= 0;
+		if (parts[0] == "block") {
+			rule.action = block;
+			ok = ok && arguments == 0;
+		} else if (parts[0] == "rewrite") {
+			rule.action = rewrite;
+			ok = ok && arguments == 1;
+		} else if (parts[0] == "stub") {
+			rule.action = stub;
+			ok = ok && arguments <= 1;
+		} else
+			ok = false;
+		if (!ok) {
+			if (errors) errors->append(QString("Invalid request rule on line %1 of %2").arg(line).arg(path));
+			continue;
+		}
+
+		rule.pattern = parts[1];
+		if (rule.action == rewrite)
+			rule.argument = QFileInfo(parts[2]).absoluteFilePath();
+		else if (rule.action == stub)
+			rule.argument = arguments == 1 ? parts[2] : "text/plain";
+		QString error;
+		if (!rules->add(rule, &error) && errors)
+			errors->append(QString("Invalid request rule on line %1 of %2: %3").arg(line).arg(path).arg(error));
+	}
+	cache[key] = rules;
+	return rules;
+}
+
+/*!
+  \brief Find loaded rules by their id, or a null pointer
+*/
+QSharedPointer<RequestRules> RequestRules::byId(int id) {
+	foreach (const QSharedPointer<RequestRules> & rules, cache)
+		if (rules->ruleSetId == id) return rules;
+	return QSharedPointer<RequestRules>();
+}
+
+/*!
+  \brief Identifies the rules for as long as the process runs
+*/
+int RequestRules::id() const {
+	return ruleSetId;
+}
+
+/*!
+  \brief Add a rule, unless its pattern is not a valid regular expression
+  \param error Set to what is wrong with the pattern of a rule not added
+*/
+bool RequestRules::add(const Rule & rule, QString * error) {
+	if (rule.pattern.startsWith("regex:")) {
+		QRegularExpression re(rule.pattern.mid(6));
+		if (!re.isValid()) {
+			if (error) *error = re.errorString();
+			return false;
+		}
+		expressions.append(qMakePair(rules.size(), re));
+		rules.append(rule);
+		return true;
+	}
+
+	int index = rules.size();
+	rules.append(rule);
+
+	if (rule.pattern.contains('*') || rule.pattern.contains('?')) {
+		QString re = QRegularExpression::escape(rule.pattern);
+		re.replace("\\*", ".*").replace("\\?", ".");
+		expressions.append(qMakePair(index, QRegularExpression("^" + re + "$")));
+		return true;
+	}
+
+	int node = 0;
+	foreach (const QChar & c, rule.pattern) {
+		int next = trie[node].children.value(c, -1);
+		if (next == -1) {
+			next = trie.size();
+			trie[node].children[c] = next;
+			trie.append(Node());
+		}
+		node = next;
+	}
+	if (trie[node].rule == -1) trie[node].rule = index;
+	return true;
+}
+
+/*!
+  \brief Find the first rule matching a url
+  \returns The rule or 0 if none matches
+*/
+const RequestRules::Rule * RequestRules::match(const QUrl & url) const {
+	QString s = url.toString();
+	int best = rules.size();
+
+	int node = 0;
+	for (int i = 0; i < s.size(); ++i) {
+		node = trie[node].children.value(s[i], -1);
+		if (node == -1) break;
+		if (trie[node].rule != -1 && trie[node].rule < best)
+			best = trie[node].rule;
+	}
+
+	for (int i = 0; i < expressions.size() && expressions[i].first < best; ++i)
+		if (expressions[i].second.match(s).hasMatch())
+			best = expressions[i].first;
+
+	return best < rules.size() ? &rules[best] : 0;
+}
+
+int RequestRules::indexOf(const Rule * rule) const {
+	for (int i = 0; i < rules.size(); ++i)
+		if (&rules[i] == rule) return i;
+	return -1;
+}
+
+/*!
+  \brief Get a rule by its position in the file, or 0 if there is no such rule
+*/
+const RequestRules::Rule * RequestRules::rule(int index) const {
+	return index >= 0 && index < rules.size() ? &rules[index] : 0;
+}
+
+}
+#include "dllend.inc"
@@ -0,0 +1,104 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __REQUESTRULES_HH__
+#define __REQUESTRULES_HH__
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QVector>
+
+#include "dllbegin.inc"
+namespace wkhtmltopdf {
+
+/*!
+  \brief Rules blocking or rewriting requests, read from a file
+
+  Every line of the file holds one rule, an action followed by a pattern
+  and for some actions an argument:
+
+  \verbatim
+  block   <pattern>
+  rewrite <pattern> <local file>
+  stub    <pattern> [mime type]
+  \endverbatim
+
+  A pattern starting with regex: is a regular expression, a pattern holding
+  * or ? is a wildcard matched against the whole url, any other pattern
+  matches urls starting with it. The first rule in the file that matches
+  a url wins. Empty lines and lines starting with # are skipped.
+
+  Prefixes are kept in a trie walked once along the url, only wildcards and
+  regular expressions from before the best prefix match are tried after it.
+*/
+class DLL_LOCAL RequestRules {
+public:
+	enum Action {
+		block,
+		rewrite,
+		stub
+	};
+
+	struct Rule {
+		Action action;
+		QString pattern;
+		//The local file for rewrite, the mime type for stub
+		QString argument;
+	};
+
+	static QSharedPointer<RequestRules> load(const QString & path, QStringList * errors);
+	static QSharedPointer<RequestRules> byId(int id);
+
+	int id() const;
+	const Rule * match(const QUrl & url) const;
+	int indexOf(const Rule * rule) const;
+	const Rule * rule(int index) const;
+private:
+	struct Node {
+		QHash<QChar, int> children;
+		//Index of the first rule with the prefix ending here, -1 if none
+		int rule;
+		Node(): rule(-1) {}
+	};
+
+	RequestRules();
+	bool add(const Rule & rule, QString * error);
+
+	int ruleSetId;
+	QList<Rule> rules;
+	QVector<Node> trie;
+	//Wildcards and regular expressions, in the order of their rules
+	QList<QPair<int, QRegularExpression> > expressions;
+
+	//Compiled rule files, by path and modification time
+	static QHash<QString, QSharedPointer<RequestRules> > cache;
+	static int nextId;
+};
+
+}
+#include "dllend.inc"
+#endif //__REQUESTRULES_HH__
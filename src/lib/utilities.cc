@@ -137,7 +137,14 @@ void MyLooksStyle::drawPrimitive( PrimitiveElement element, const QStyleOption *
 	}
 }
 
-int handleError(bool success, int errorCode) {
+/*!
+ * Compute the exit code of a conversion and describe why it failed
+ * \param success did the conversion succeed
+ * \param errorCode the http or network error code of the conversion
+ * \param message if not null, the description is stored here instead of
+ *        being written to stderr
+ */
+int handleError(bool success, int errorCode, QString * message) {
 	QHash<int, const char *> cm;
 	cm[400] = "Bad Request";
 	cm[401] = "Unauthorized";
@@ -152,13 +159,15 @@ int handleError(bool success, int errorCode) {
 	QHash<int, int> ce;
 	ce[404] = 2;
 	ce[401] = 3;
+	int c = EXIT_SUCCESS;
+	QString msg;
 	if (errorCode) {
-		int c = EXIT_FAILURE;
+		c = EXIT_FAILURE;
 		if (ce.contains(errorCode)) c = ce[errorCode];
 		const char * m = "";
 		if (cm.contains(errorCode)) m = cm[errorCode];
 		if (errorCode < 1000) {
-			fprintf(stderr, "Exit with code %d due to http error: %d %s\n", c, errorCode, m);
+			msg = QString("Exit with code %1 due to http error: %2 %3").arg(c).arg(errorCode).arg(m);
 		} else {
 			QNetworkReply::NetworkError error = (QNetworkReply::NetworkError)(errorCode - 1000);
 			QString errorValue;
@@ -170,13 +179,15 @@ int handleError(bool success, int errorCode) {
 					break;
 				}
 			}
-			fprintf(stderr, "Exit with code %d due to network error: %s\n", c, errorValue.toLocal8Bit().data());
+			msg = QString("Exit with code %1 due to network error: %2").arg(c).arg(errorValue);
 		}
-		return c;
 	} else if (!success) {
-		fprintf(stderr, "Exit with code %d, due to unknown error.\n", EXIT_FAILURE);
+		c = EXIT_FAILURE;
+		msg = QString("Exit with code %1, due to unknown error.").arg(c);
 	}
-	return success?EXIT_SUCCESS:EXIT_FAILURE;
+	if (message) *message = msg;
+	else if (!msg.isEmpty()) fprintf(stderr, "%s\n", msg.toLocal8Bit().data());
+	return c;
 }
 
 QSvgRenderer * MyLooksStyle::checkbox = 0;
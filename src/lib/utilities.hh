@@ -55,7 +55,7 @@ public slots:
 	void setRadioButtonCheckedSvg(const QString & path);
 };
 
-DLL_PUBLIC int handleError(bool success, int errorCode);
+DLL_PUBLIC int handleError(bool success, int errorCode, QString * message=0);
 
 #include <dllend.inc>
 #endif //__UTILITIES_HH__
@@ -0,0 +1,149 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "batchrunner.hh"
+#include "conversionjob.hh"
+#include "pdfcommandlineparser.hh"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSocketNotifier>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+/*!
+  \param args the arguments given to wkhtmltopdf, starting with the program name
+  \param parallel the maximal number of lines converted at the same time
+  \param results report every line as a JSON object on stdout
+  \param parent the owner of the runner
+*/
+BatchRunner::BatchRunner(const QList<QByteArray> & args, int parallel, bool results, QObject * parent):
+	QObject(parent), args(args), parallel(qMax(parallel, 1)), results(results), notifier(0),
+	running(0), lines(0), eof(false), failed(false) {}
+
+/*!
+  Convert every line on stdin
+  \return the exit code of the batch, failure if any line failed
+*/
+int BatchRunner::run() {
+#ifdef Q_OS_UNIX
+	notifier = new QSocketNotifier(STDIN_FILENO, QSocketNotifier::Read, this);
+	connect(notifier, SIGNAL(activated(int)), this, SLOT(readInput()));
+#else
+	//There is no notifier for a console or pipe here, read a line at a time
+	QMetaObject::invokeMethod(this, "readInput", Qt::QueuedConnection);
+#endif
+	loop.exec();
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*!
+  Read what stdin has and start the lines that are complete
+*/
+void BatchRunner::readInput() {
+#ifdef Q_OS_UNIX
+	char chunk[64*1024];
+	ssize_t r;
+	do r = ::read(STDIN_FILENO, chunk, sizeof(chunk)); while (r < 0 && errno == EINTR);
+	if (r > 0)
+		input.append(chunk, r);
+	else
+		eof = true;
+#else
+	char * buff = fgets_large(stdin);
+	if (buff) {
+		input.append(buff);
+		free(buff);
+	} else
+		eof = true;
+#endif
+	startJobs();
+}
+
+/*!
+  Start the complete lines read until enough jobs are running
+*/
+void BatchRunner::startJobs() {
+	while (running < parallel) {
+		int end = input.indexOf('\n');
+		//The last line need not be terminated
+		if (end < 0 && !(eof && !input.isEmpty())) break;
+		QByteArray line = end < 0 ? input : input.left(end);
+		input.remove(0, end < 0 ? input.size() : end + 1);
+
+		QList<QByteArray> a = args;
+		int nargc = 0;
+		char ** nargv;
+		parseString(line.data(), nargc, &nargv);
+		for (int i=0; i < nargc; ++i) a << QByteArray(nargv[i]);
+		free(nargv);
+
+		ConversionJob * job = new ConversionJob(a, this);
+		indexes[job] = lines++;
+		++running;
+		connect(job, SIGNAL(finished(ConversionJob *)), this, SLOT(jobFinished(ConversionJob *)));
+		job->start();
+	}
+	//Only read on while there is no complete line waiting for a free job
+	bool waiting = input.contains('\n');
+	if (notifier) notifier->setEnabled(!eof && !waiting);
+#ifndef Q_OS_UNIX
+	if (!eof && !waiting && running < parallel)
+		QMetaObject::invokeMethod(this, "readInput", Qt::QueuedConnection);
+#endif
+	if (eof && input.isEmpty() && running == 0) loop.quit();
+}
+
+/*!
+  Report the outcome of a line and start the next ones
+*/
+void BatchRunner::jobFinished(ConversionJob * job) {
+	--running;
+	if (!job->success()) failed = true;
+
+	int index = indexes.take(job);
+	if (results) {
+		QJsonObject r;
+		r["index"] = index;
+		r["exitCode"] = job->exitCode();
+		r["httpErrorCode"] = job->httpErrorCode();
+		r["time"] = double(job->elapsed());
+		r["bytes"] = double(job->outputSize());
+		r["errors"] = QJsonArray::fromStringList(job->errors());
+		if (job->success() && !job->output().isEmpty())
+			r["data"] = QString::fromLatin1(job->output().toBase64());
+		fprintf(stdout, "%s\n", QJsonDocument(r).toJson(QJsonDocument::Compact).constData());
+	} else {
+		//Documents are written whole, so concurrent lines do not interleave on stdout
+		foreach (const QString & error, job->errors())
+			fprintf(stderr, "Error: %s\n", error.toLocal8Bit().constData());
+		if (job->success() && !job->output().isEmpty())
+			fwrite(job->output().constData(), 1, job->output().size(), stdout);
+	}
+	fflush(stdout);
+	job->deleteLater();
+
+	//The job may have finished from within startJobs, read on from the event loop
+	QMetaObject::invokeMethod(this, "startJobs", Qt::QueuedConnection);
+}
@@ -0,0 +1,65 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __BATCHRUNNER_HH__
+#define __BATCHRUNNER_HH__
+#include <QByteArray>
+#include <QEventLoop>
+#include <QHash>
+#include <QList>
+#include <QObject>
+
+class QSocketNotifier;
+class ConversionJob;
+
+/*!
+  \brief Runs the jobs read with --read-args-from-stdin
+
+  Up to a given number of lines are converted at the same time, and the
+  outcome of every line is reported as soon as it is known. A failing
+  line does not stop the batch. Stdin is read as data arrives, so a slow
+  writer does not block the conversions that are running.
+*/
+class BatchRunner: public QObject {
+	Q_OBJECT
+public:
+	BatchRunner(const QList<QByteArray> & args, int parallel, bool results, QObject * parent=0);
+	int run();
+private slots:
+	void readInput();
+	void startJobs();
+	void jobFinished(ConversionJob * job);
+private:
+	//Arguments given to wkhtmltopdf, prepended to the ones of every line
+	QList<QByteArray> args;
+	int parallel;
+	//Report every line as a JSON object instead of writing documents as they are
+	bool results;
+	QSocketNotifier * notifier;
+	//Read from stdin but not yet started
+	QByteArray input;
+	int running;
+	int lines;
+	bool eof;
+	bool failed;
+	QHash<ConversionJob *, int> indexes;
+	QEventLoop loop;
+};
+#endif //__BATCHRUNNER_HH__
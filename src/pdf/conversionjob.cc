@@ -0,0 +1,116 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "conversionjob.hh"
+#include "pdfcommandlineparser.hh"
+#include <QFileInfo>
+#include <QVector>
+#include <cstdlib>
+#include <utilities.hh>
+
+using namespace wkhtmltopdf::settings;
+using namespace wkhtmltopdf;
+
+/*!
+  \param args the arguments of the job, starting with the program name
+  \param parent the owner of the job
+*/
+ConversionJob::ConversionJob(const QList<QByteArray> & args, QObject * parent):
+	QObject(parent), args(args), converter(0), toMemory(false), onlyMemory(false),
+	ok(false), code(EXIT_FAILURE), httpCode(0), pages(0), time(0), size(0) {}
+
+ConversionJob::~ConversionJob() {
+	delete converter;
+}
+
+/*!
+  Parse the arguments and start converting, finished is emitted once done
+*/
+void ConversionJob::start() {
+	timer.start();
+	QVector<const char *> argv;
+	foreach (const QByteArray & arg, args) argv << arg.constData();
+	argv << 0;
+
+	PdfCommandLineParser parser(globalSettings, objectSettings);
+	parser.exitOnError = false;
+	parser.parseArguments(args.size(), argv.data(), true);
+	if (parser.error) {
+		errorList << parser.errorString;
+		QMetaObject::invokeMethod(this, "parseFailed", Qt::QueuedConnection);
+		return;
+	}
+	if (onlyMemory && globalSettings.out != "-") {
+		errorList << "Jobs may only write their output to -";
+		QMetaObject::invokeMethod(this, "parseFailed", Qt::QueuedConnection);
+		return;
+	}
+
+	//There is no stdout to write to, keep the document for the caller instead
+	if (globalSettings.out == "-") {
+		globalSettings.out.clear();
+		toMemory = true;
+	}
+
+	converter = new PdfConverter(globalSettings);
+	converter->setQuitOnFinished(false);
+	connect(converter, SIGNAL(finished(bool)), this, SLOT(converterFinished(bool)));
+	connect(converter, SIGNAL(error(const QString &)), this, SLOT(error(const QString &)));
+	connect(converter, SIGNAL(warning(const QString &)), this, SLOT(warning(const QString &)));
+	foreach (const PdfObject & object, objectSettings)
+		converter->addResource(object);
+	converter->beginConversion();
+}
+
+/*!
+  Stop converting, finished is emitted with the job failed
+*/
+void ConversionJob::cancel() {
+	if (converter) converter->cancel();
+}
+
+void ConversionJob::converterFinished(bool success) {
+	ok = success;
+	httpCode = converter->httpErrorCode();
+	pages = converter->pageCount();
+	if (toMemory) {
+		data = converter->output();
+		size = data.size();
+	} else if (success)
+		size = QFileInfo(globalSettings.out).size();
+	QString message;
+	code = handleError(ok, httpCode, &message);
+	if (!message.isEmpty()) errorList << message;
+	time = timer.elapsed();
+	emit finished(this);
+}
+
+void ConversionJob::parseFailed() {
+	time = timer.elapsed();
+	emit finished(this);
+}
+
+void ConversionJob::error(const QString & message) {
+	errorList << message;
+}
+
+void ConversionJob::warning(const QString & message) {
+	warningList << message;
+}
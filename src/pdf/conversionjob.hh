@@ -0,0 +1,84 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __CONVERSIONJOB_HH__
+#define __CONVERSIONJOB_HH__
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <pdfconverter.hh>
+#include <pdfsettings.hh>
+
+/*!
+  \brief One invocation of wkhtmltopdf run inside an already running application
+
+  The arguments are parsed as if they were given on the command line, but
+  invalid arguments and failed conversions are reported by the job instead
+  of ending the process.
+*/
+class ConversionJob: public QObject {
+	Q_OBJECT
+public:
+	ConversionJob(const QList<QByteArray> & args, QObject * parent=0);
+	~ConversionJob();
+	void start();
+	void cancel();
+	//Refuse to write the document anywhere but to memory
+	void setMemoryOnly(bool memoryOnly) {onlyMemory = memoryOnly;}
+
+	bool success() const {return ok;}
+	int exitCode() const {return code;}
+	int httpErrorCode() const {return httpCode;}
+	int pageCount() const {return pages;}
+	qint64 elapsed() const {return time;}
+	qint64 outputSize() const {return size;}
+	//The document, when it was written to - and is kept in memory
+	const QByteArray & output() const {return data;}
+	const QStringList & errors() const {return errorList;}
+	const QStringList & warnings() const {return warningList;}
+signals:
+	void finished(ConversionJob * job);
+private slots:
+	void converterFinished(bool ok);
+	void parseFailed();
+	void error(const QString & message);
+	void warning(const QString & message);
+private:
+	QList<QByteArray> args;
+	wkhtmltopdf::settings::PdfGlobal globalSettings;
+	QList<wkhtmltopdf::settings::PdfObject> objectSettings;
+	wkhtmltopdf::PdfConverter * converter;
+	QElapsedTimer timer;
+	bool toMemory;
+	bool onlyMemory;
+
+	bool ok;
+	int code;
+	int httpCode;
+	int pages;
+	qint64 time;
+	qint64 size;
+	QByteArray data;
+	QStringList errorList;
+	QStringList warningList;
+};
+#endif //__CONVERSIONJOB_HH__
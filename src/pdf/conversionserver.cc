@@ -0,0 +1,232 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "conversionserver.hh"
+#include "conversionjob.hh"
+#include "pdfcommandlineparser.hh"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QSet>
+#include <cstdlib>
+
+using namespace wkhtmltopdf::settings;
+
+//The longest request line accepted from a client
+static const qint64 maxRequestSize = 1024 * 1024;
+
+//Switches reaching outside of a job, only accepted on the command line of the server
+static const char * serverOnlySwitches[] = {
+	"read-args-from-stdin", "batch-results", "jobs", "server", "help", "extended-help",
+	"version", "license", "manpage", "htmldoc", "readme", "dump-outline",
+	"dump-default-toc-xsl", "dump-network-timings", "cookie-jar", "cache-dir",
+	"enable-local-file-access", "allow", "request-rules", "post-file", "ssl-key-path",
+	"ssl-crt-path", "user-style-sheet", "xsl-style-sheet", "checkbox-svg",
+	"checkbox-checked-svg", "radiobutton-svg", "radiobutton-checked-svg",
+	"memory-cache-size", "share-memory-cache", "share-connections", "use-xserver", 0};
+
+/*!
+  Send a reply to a client as a single line
+*/
+static void reply(QLocalSocket * socket, const QJsonObject & object) {
+	socket->write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+	socket->write("\n");
+}
+
+/*!
+  \param args the arguments given to wkhtmltopdf, starting with the program name
+  \param parallel the number of jobs to run at the same time
+  \param parent the owner of the server
+*/
+ConversionServer::ConversionServer(const QList<QByteArray> & args, int parallel, QObject * parent):
+	QObject(parent), args(args), parallel(qMax(parallel, 1)) {
+	connect(&server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+/*!
+  Start listening, a stale socket left by an earlier server is removed
+  \param name the name or path of the local socket
+*/
+bool ConversionServer::listen(const QString & name) {
+	QLocalServer::removeServer(name);
+	return server.listen(name);
+}
+
+QString ConversionServer::errorString() const {
+	return server.errorString();
+}
+
+void ConversionServer::newConnection() {
+	while (server.hasPendingConnections()) {
+		QLocalSocket * socket = server.nextPendingConnection();
+		//Lines that are not read yet are left to the client, which limits what one may queue
+		socket->setReadBufferSize(maxRequestSize);
+		clients << socket;
+		connect(socket, SIGNAL(readyRead()), this, SLOT(readJobs()));
+		connect(socket, SIGNAL(disconnected()), this, SLOT(clientGone()));
+		connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+	}
+}
+
+void ConversionServer::readJobs() {
+	QLocalSocket * socket = qobject_cast<QLocalSocket *>(sender());
+	if (socket) readJobs(socket);
+}
+
+/*!
+  Cancel the jobs of a client that went away, no one is left to receive them
+*/
+void ConversionServer::clientGone() {
+	QLocalSocket * socket = qobject_cast<QLocalSocket *>(sender());
+	clients.removeAll(socket);
+	QList<ConversionJob *> gone;
+	for (QHash<ConversionJob *, Client>::iterator i=jobs.begin(); i != jobs.end(); ++i) {
+		if (i.value().socket != socket) continue;
+		i.value().socket = 0;
+		gone << i.key();
+	}
+	//Cancelling may finish a job right away, which changes jobs
+	foreach (ConversionJob * job, gone)
+		if (jobs.contains(job)) job->cancel();
+}
+
+/*!
+  Find a switch in the arguments of a job that only the server may be given
+  \param jobArgs the arguments sent by the client
+  \return the offending switch, or an empty string if there is none
+*/
+QString ConversionServer::forbiddenSwitch(const QList<QByteArray> & jobArgs) const {
+	PdfGlobal globalSettings;
+	QList<PdfObject> objectSettings;
+	PdfCommandLineParser parser(globalSettings, objectSettings);
+	QSet<QString> forbidden;
+	for (int i=0; serverOnlySwitches[i]; ++i) forbidden.insert(serverOnlySwitches[i]);
+
+	foreach (const QByteArray & arg, jobArgs) {
+		if (arg.size() < 2 || arg[0] != '-') continue;
+		if (arg[1] == '-') {
+			QString name = QString::fromLocal8Bit(arg.mid(2));
+			if (forbidden.contains(name)) return "--" + name;
+			continue;
+		}
+		for (int j=1; j < arg.size(); ++j) {
+			ArgHandler * handler = parser.shortToHandler.value(arg[j]);
+			if (handler && forbidden.contains(handler->longName))
+				return QString("-%1").arg(QChar(arg[j]));
+		}
+	}
+	return QString();
+}
+
+/*!
+  Start a job for every complete line received on a connection, as long as
+  fewer than parallel jobs are running
+*/
+void ConversionServer::readJobs(QLocalSocket * socket) {
+	if (!socket->canReadLine() && socket->bytesAvailable() >= maxRequestSize) {
+		QJsonObject r;
+		r["ok"] = false;
+		r["exitCode"] = EXIT_FAILURE;
+		r["errors"] = QJsonArray() << QString("Invalid job: the request is longer than %1 bytes").arg(maxRequestSize);
+		reply(socket, r);
+		socket->disconnectFromServer();
+		return;
+	}
+	while (jobs.size() < parallel && socket->canReadLine()) {
+		QByteArray line = socket->readLine().trimmed();
+		if (line.isEmpty()) continue;
+
+		QJsonParseError parseError;
+		QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+		QJsonObject request = doc.object();
+		QJsonValue jobArgs = request.value("args");
+		if (!doc.isObject() || !(jobArgs.isArray() || jobArgs.isString())) {
+			QJsonObject r;
+			if (request.contains("id")) r["id"] = request.value("id");
+			r["ok"] = false;
+			r["exitCode"] = EXIT_FAILURE;
+			QString message = parseError.error != QJsonParseError::NoError ?
+				parseError.errorString() : QString("No args in the job");
+			r["errors"] = QJsonArray() << QString("Invalid job: %1").arg(message);
+			reply(socket, r);
+			continue;
+		}
+
+		QList<QByteArray> given;
+		if (jobArgs.isString()) {
+			QByteArray buff = jobArgs.toString().toLocal8Bit();
+			int nargc = 0;
+			char ** nargv;
+			parseString(buff.data(), nargc, &nargv);
+			for (int i=0; i < nargc; ++i) given << QByteArray(nargv[i]);
+			free(nargv);
+		} else {
+			foreach (const QJsonValue & v, jobArgs.toArray())
+				given << v.toString().toLocal8Bit();
+		}
+
+		QString forbidden = forbiddenSwitch(given);
+		if (!forbidden.isEmpty()) {
+			QJsonObject r;
+			if (request.contains("id")) r["id"] = request.value("id");
+			r["ok"] = false;
+			r["exitCode"] = EXIT_FAILURE;
+			r["errors"] = QJsonArray() << QString("Invalid job: %1 may only be given to the server").arg(forbidden);
+			reply(socket, r);
+			continue;
+		}
+
+		ConversionJob * job = new ConversionJob(args + given, this);
+		job->setMemoryOnly(true);
+		Client & client = jobs[job];
+		client.socket = socket;
+		client.id = request.value("id");
+		connect(job, SIGNAL(finished(ConversionJob *)), this, SLOT(jobFinished(ConversionJob *)));
+		job->start();
+	}
+}
+
+/*!
+  Report the outcome of a job to the client that sent it
+*/
+void ConversionServer::jobFinished(ConversionJob * job) {
+	Client client = jobs.take(job);
+	job->deleteLater();
+	//A job slot is free, pick up lines left waiting
+	foreach (QLocalSocket * socket, clients)
+		if (socket && socket != client.socket) readJobs(socket);
+	//The client went away, there is no one left to tell
+	if (!client.socket) return;
+
+	QJsonObject r;
+	if (!client.id.isUndefined()) r["id"] = client.id;
+	r["ok"] = job->success();
+	r["exitCode"] = job->exitCode();
+	r["httpErrorCode"] = job->httpErrorCode();
+	r["pageCount"] = job->pageCount();
+	r["time"] = double(job->elapsed());
+	r["errors"] = QJsonArray::fromStringList(job->errors());
+	r["warnings"] = QJsonArray::fromStringList(job->warnings());
+	if (job->success() && !job->output().isEmpty())
+		r["data"] = QString::fromLatin1(job->output().toBase64());
+	reply(client.socket, r);
+	readJobs(client.socket);
+}
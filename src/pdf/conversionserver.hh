@@ -0,0 +1,72 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef __CONVERSIONSERVER_HH__
+#define __CONVERSIONSERVER_HH__
+#include <QByteArray>
+#include <QHash>
+#include <QJsonValue>
+#include <QList>
+#include <QLocalServer>
+#include <QObject>
+#include <QPointer>
+
+class QLocalSocket;
+class ConversionJob;
+
+/*!
+  \brief Accepts conversion jobs on a local socket
+
+  Every line received is a JSON object describing one job, every job is
+  answered by a line holding a JSON object once it is done. Jobs from all
+  connections run concurrently in the event loop of the application, at
+  most parallel of them at a time. Jobs run with the privileges of the
+  server, so switches that reach outside of the job are only accepted from
+  the server's own command line.
+*/
+class ConversionServer: public QObject {
+	Q_OBJECT
+public:
+	ConversionServer(const QList<QByteArray> & args, int parallel, QObject * parent=0);
+	bool listen(const QString & name);
+	QString errorString() const;
+private slots:
+	void newConnection();
+	void readJobs();
+	void clientGone();
+	void jobFinished(ConversionJob * job);
+private:
+	void readJobs(QLocalSocket * socket);
+	QString forbiddenSwitch(const QList<QByteArray> & jobArgs) const;
+
+	struct Client {
+		QPointer<QLocalSocket> socket;
+		QJsonValue id;
+	};
+
+	QLocalServer server;
+	//Arguments given to wkhtmltopdf, prepended to the ones of every job
+	QList<QByteArray> args;
+	//The number of jobs allowed to run at the same time
+	int parallel;
+	QList<QPointer<QLocalSocket> > clients;
+	QHash<ConversionJob *, Client> jobs;
+};
+#endif //__CONVERSIONSERVER_HH__
@@ -59,5 +59,6 @@ CONFIG(shared, shared|static) {
 }
 
 #Application part
+HEADERS += conversionjob.hh conversionserver.hh batchrunner.hh
 SOURCES += wkhtmltopdf.cc pdfarguments.cc pdfcommandlineparser.cc \
-           pdfdocparts.cc
+           pdfdocparts.cc conversionjob.cc conversionserver.cc batchrunner.cc
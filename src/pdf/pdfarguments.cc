@@ -166,6 +166,9 @@ struct BookFunc {
 */
 PdfCommandLineParser::PdfCommandLineParser(PdfGlobal & s, QList<PdfObject> & ps):
 	readArgsFromStdin(false),
+	batchResults(false),
+	jobs(-1),
+	serverName(),
 	globalSettings(s),
 	pageSettings(ps) {
 	section("Global Options");
@@ -192,6 +195,10 @@ PdfCommandLineParser::PdfCommandLineParser(PdfGlobal & s, QList<PdfObject> & ps)
  	addarg("title", 0, "The title of the generated pdf file (The title of the first document is used if not specified)", new QStrSetter(s.documentTitle,"text"));
 
 	addarg("read-args-from-stdin", 0, "Read command line arguments from stdin", new ConstSetter<bool>(readArgsFromStdin, true) );
+	addarg("batch-results", 0, "Report the outcome of every line read with --read-args-from-stdin on stdout as JSON", new ConstSetter<bool>(batchResults, true) );
+	addarg("jobs", 'j', "Number of jobs to convert at the same time, by default 1 with --read-args-from-stdin and 4 with --server", new IntSetter(jobs, "number") );
+	addarg("server", 0, "Accept conversion jobs on the given local socket instead of converting once", new QStrSetter(serverName, "name") );
+	addarg("dump-network-timings", 0, "Write the timing of every request made while loading to a file, as a HAR log; phases that were not measured are -1, which with WebKit is always the case for dns, connect and ssl", new QStrSetter(s.dumpNetworkTimings, "file"));
 
 	extended(true);
  	qthack(false);
@@ -261,7 +268,7 @@ PdfCommandLineParser::PdfCommandLineParser(PdfGlobal & s, QList<PdfObject> & ps)
  	addarg("resolve-relative-links", 0, "Resolve relative external links into absolute links", new ConstSetter<bool>(s.resolveRelativeLinks, true));
  	addarg("keep-relative-links", 0, "Keep relative external links as relative external links", new ConstSetter<bool>(s.resolveRelativeLinks, false));
 
-	addarg("enable-toc-back-links",0,"Link from section header to toc", new ConstSetter<bool>(od.toc.backLinks,true));
+	addarg("enable-toc-back-links",0,"Link from section header to toc (WebKit only)", new ConstSetter<bool>(od.toc.backLinks,true));
 	addarg("disable-toc-back-links",0,"Do not link from section header to toc", new ConstSetter<bool>(od.toc.backLinks,false));
 
 	addPageLoadArgs(od.load);
@@ -43,6 +43,7 @@ void PdfCommandLineParser::manpage(FILE * fd) const {
  	outputDescripton(o);
 	outputSwitches(o, true, false);
 	outputProxyDoc(o);
+	outputRequestRulesDoc(o);
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
  	outputHeaderFooterDoc(o);
  	outputOutlineDoc(o);
@@ -76,6 +77,7 @@ void PdfCommandLineParser::usage(FILE * fd, bool extended) const {
 		outputPageSizes(o);
 		outputArgsFromStdin(o);
 		outputProxyDoc(o);
+		outputRequestRulesDoc(o);
 		outputHeaderFooterDoc(o);
 		outputOutlineDoc(o);
 		outputTableOfContentDoc(o);
@@ -99,6 +101,7 @@ void PdfCommandLineParser::readme(FILE * fd, bool html) const {
 	outputSynopsis(o);
 	outputSwitches(o, true, true);
  	outputProxyDoc(o);
+ 	outputRequestRulesDoc(o);
  	outputHeaderFooterDoc(o);
  	outputOutlineDoc(o);
 	outputTableOfContentDoc(o);
@@ -149,9 +152,10 @@ void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fro
 	for (;arg < argc;++arg) {
 		if (argv[arg][0] != '-' || argv[arg][1] == '\0' || defaultMode) break;
 		parseArg(global | page, argc, argv, defaultMode, arg, (char *)&def);
+		if (error) return;
 	}
 
-	if (readArgsFromStdin && !fromStdin) return;
+	if ((readArgsFromStdin || !serverName.isEmpty()) && !fromStdin) return;
 
 	//Parse page options
 	while (arg < argc-1) {
@@ -161,15 +165,15 @@ void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fro
 		if (!strcmp(argv[arg],"cover")) {
 			++arg;
 			if (arg >= argc-1) {
-				fprintf(stderr, "You need to specify a input file to cover\n\n");
-				usage(stderr, false);
-				exit(1);
+				parseError("You need to specify a input file to cover");
+				return;
 			}
 			ps.page = QString::fromLocal8Bit(argv[arg++]);
 			// parse page options and then override the header/footer settings
 			for (;arg < argc;++arg) {
 				if (argv[arg][0] != '-' || argv[arg][1] == '\0' || defaultMode) break;
 				parseArg(sections, argc, argv, defaultMode, arg, (char*)&ps);
+				if (error) return;
 			}
 
 			ps.header.left = ps.header.right = ps.header.center = "";
@@ -187,9 +191,8 @@ void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fro
 			if (!strcmp(argv[arg],"page")) {
 				++arg;
 				if (arg >= argc-1) {
-					fprintf(stderr, "You need to specify a input file to page\n\n");
-					usage(stderr, false);
-					exit(1);
+					parseError("You need to specify a input file to page");
+					return;
 				}
 			}
 			QByteArray a(argv[arg]);
@@ -199,13 +202,13 @@ void PdfCommandLineParser::parseArguments(int argc, const char ** argv, bool fro
 		for (;arg < argc;++arg) {
 			if (argv[arg][0] != '-' || argv[arg][1] == '\0' || defaultMode) break;
 			parseArg(sections, argc, argv, defaultMode, arg, (char*)&ps);
+			if (error) return;
 		}
 	}
 
 	if (pageSettings.size() == 0 || argc < 2) {
-		fprintf(stderr, "You need to specify at least one input file, and exactly one output file\nUse - for stdin or stdout\n\n");
-		usage(stderr, false);
-		exit(1);
+		parseError("You need to specify at least one input file, and exactly one output file\nUse - for stdin or stdout");
+		return;
 	}
 	globalSettings.out = QString::fromLocal8Bit(argv[argc-1]);
 }
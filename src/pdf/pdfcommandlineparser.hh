@@ -30,6 +30,9 @@ public:
 	const static int page = 2;
 	const static int toc = 4;
 	bool readArgsFromStdin;
+	bool batchResults;
+	int jobs;
+	QString serverName;
 	wkhtmltopdf::settings::PdfGlobal & globalSettings;
 	QList<wkhtmltopdf::settings::PdfObject> & pageSettings;
 
@@ -70,4 +73,8 @@ public:
 	}
 
 };
+
+//wkhtmltopdf.cc
+void parseString(char * buff, int &nargc, char ***nargv);
+char * fgets_large(FILE * fp);
 #endif //__PDFCOMMANDLINEPARSER_HH__
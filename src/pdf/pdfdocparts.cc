@@ -332,6 +332,43 @@ void PdfCommandLineParser::outputArgsFromStdin(Outputter * o) const {
 	o->verbatim("echo \"https://doc.qt.io/archives/qt-4.8/qapplication.html qapplication.pdf\" >> cmds\n"
 				"echo \"cover google.com https://en.wikipedia.org/wiki/Qt_(software) qt.pdf\" >> cmds\n"
 				"wkhtmltopdf --read-args-from-stdin --book < cmds\n");
+	o->paragraph("Use -j to convert several lines at the same time. A line that fails does not "
+				 "stop the batch, its errors are written to stderr and the exit code of "
+				 "wkhtmltopdf is 1 if any line failed. A line whose output file is - has its "
+				 "document written to stdout once it is done.");
+	o->paragraph("With --batch-results the outcome of every line is written to stdout as a line "
+				 "holding a JSON object instead, with the \"index\" of the line counting from 0, "
+				 "the \"exitCode\", the \"httpErrorCode\", the \"time\" taken in milliseconds, "
+				 "the number of \"bytes\" written and the \"errors\" reported. When the output "
+				 "file of a line is - the document is sent base64 encoded in \"data\".");
+	o->verbatim("wkhtmltopdf --read-args-from-stdin --batch-results -j 4 --book < cmds > results\n");
+	o->endSection();
+
+	o->beginSection("Running as a conversion server");
+	o->paragraph("With --server wkhtmltopdf starts once and accepts conversion jobs on a "
+				 "local socket (a unix domain socket or a named pipe on windows), so the "
+				 "start up cost is only paid once. Jobs are run concurrently and a failing "
+				 "job does not stop the server.");
+	o->paragraph("Every job is a line holding a JSON object, with the arguments of the job in "
+				 "\"args\", either as a list or as a single string split like a line read with "
+				 "--read-args-from-stdin. These are combined with the arguments given to "
+				 "wkhtmltopdf. Once the job is done a line holding a JSON object is sent back, "
+				 "with the \"id\" of the job, if any, \"ok\", the \"exitCode\" wkhtmltopdf would "
+				 "have exited with, the \"httpErrorCode\", the \"pageCount\", the \"time\" taken in "
+				 "milliseconds and the \"errors\" and \"warnings\" reported. When the output "
+				 "file is - the document is sent back base64 encoded in \"data\".");
+	o->paragraph("Jobs run with the privileges of the server, anyone able to connect to the "
+				 "socket can have it read the pages and files the server user can read. "
+				 "Restrict access to the socket accordingly. The output of a job must be -, "
+				 "and switches that reach outside of a job, such as --enable-local-file-access, "
+				 "--allow, --cookie-jar, --cache-dir or the style sheet and svg files, are "
+				 "refused in a job and must be given to the server instead. At most --jobs "
+				 "jobs are run at the same time, further lines wait until one is done. A "
+				 "request line may not be longer than 1 MiB, and the jobs of a client that "
+				 "disconnects are cancelled.");
+	o->paragraph("For example:");
+	o->verbatim("wkhtmltopdf --server /tmp/wkhtmltopdf.sock &\n"
+				"echo '{\"id\": 1, \"args\": [\"google.com\", \"-\"]}' | nc -U /tmp/wkhtmltopdf.sock\n");
 	o->endSection();
 }
 
@@ -18,6 +18,8 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
 
+#include "batchrunner.hh"
+#include "conversionserver.hh"
 #include "pdfcommandlineparser.hh"
 #include "progressfeedback.hh"
 #include <QCommonStyle>
@@ -31,6 +33,7 @@
 #include <string.h>
 #include <pdfconverter.hh>
 #include <pdfsettings.hh>
+#include <renderengine.hh>
 #include <utilities.hh>
 
 #if defined(Q_OS_UNIX)
@@ -181,6 +184,7 @@ int main(int argc, char * argv[]) {
 	parser.parseArguments(argc, (const char**)argv);
 
 	//Construct QApplication required for printing
+	RenderEngineFactory::initialize();
 	bool use_graphics=true;
 #if defined(Q_OS_UNIX) || defined(Q_OS_MAC)
 #ifdef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
@@ -192,34 +196,26 @@ int main(int argc, char * argv[]) {
 	MyLooksStyle * style = new MyLooksStyle();
 	a.setStyle(style);
 
-	if (parser.readArgsFromStdin) {
-		char *buff;
-		while ((buff = fgets_large(stdin)) != NULL) {
-			int nargc=argc;
-			char **nargv;
-			parseString(buff,nargc,&nargv);
-			for (int i=0; i < argc; ++i) nargv[i] = argv[i];
-
-			PdfGlobal globalSettings;
-			QList<PdfObject> objectSettings;
-			//Create a command line parser to parse commandline arguments
-			PdfCommandLineParser parser(globalSettings, objectSettings);
-			//Setup default values in settings
-			//parser.loadDefaults();
-			//Parse the arguments
-			parser.parseArguments(nargc, (const char**)nargv, true);
-
-			PdfConverter converter(globalSettings);
-			ProgressFeedback feedback(globalSettings.logLevel, converter);
-			foreach (const PdfObject & object, objectSettings)
-				converter.addResource(object);
-
-			if (!converter.convert())
-				exit(EXIT_FAILURE);
-			free(buff);
-			free(nargv);
+	QList<QByteArray> args;
+	for (int i=0; i < argc; ++i) args << QByteArray(argv[i]);
+
+	if (!parser.serverName.isEmpty()) {
+		ConversionServer server(args, parser.jobs > 0 ? parser.jobs : 4);
+		if (!server.listen(parser.serverName)) {
+			fprintf(stderr, "Could not listen on %s: %s\n", parser.serverName.toLocal8Bit().constData(),
+					server.errorString().toLocal8Bit().constData());
+			return EXIT_FAILURE;
 		}
-		exit(EXIT_SUCCESS);
+		//Have pages ready before the first job arrives
+		PdfObject defaults;
+		RenderPagePool * pool = RenderPagePool::instance();
+		pool->warm(RenderEngineFactory::defaultBackend(), defaults.web, defaults.load, pool->capacity());
+		return a.exec();
+	}
+
+	if (parser.readArgsFromStdin) {
+		BatchRunner batch(args, parser.jobs > 0 ? parser.jobs : 1, parser.batchResults);
+		return batch.run();
 	}
 	//Create the actual page converter to convert the pages
 	PdfConverter converter(globalSettings);
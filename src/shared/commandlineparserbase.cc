@@ -102,6 +102,19 @@ void CommandLineParserBase::license(FILE * fd) const {
 	delete o;
 }
 
+/*!
+  Report invalid arguments, exiting unless exitOnError is cleared
+  \param message description of what is wrong with the arguments
+*/
+void CommandLineParserBase::parseError(const QString & message) {
+	error = true;
+	errorString = message;
+	if (!exitOnError) return;
+	fprintf(stderr, "%s\n\n", message.toLocal8Bit().constData());
+	usage(stderr, false);
+	exit(1);
+}
+
 void CommandLineParserBase::parseArg(int sections, const int argc, const char ** argv, bool & defaultMode, int & arg, char * page) {
 	if (argv[arg][1] == '-') { //We have a long style argument
 		//After an -- apperas in the argument list all that follows is interpreted as default arguments
@@ -112,25 +125,21 @@ void CommandLineParserBase::parseArg(int sections, const int argc, const char **
 		//Try to find a handler for this long switch
 		QHash<QString, ArgHandler*>::iterator j = longToHandler.find(argv[arg]+2);
 		if (j == longToHandler.end()) { //Ups that argument did not exist
-			fprintf(stderr, "Unknown long argument %s\n\n", argv[arg]);
-			usage(stderr, false);
-			exit(1);
+			parseError(QString("Unknown long argument %1").arg(argv[arg]));
+			return;
 		}
 		if (!(j.value()->section & sections)) {
-			fprintf(stderr, "%s specified in incorrect location\n\n", argv[arg]);
-			usage(stderr, false);
-			exit(1);
+			parseError(QString("%1 specified in incorrect location").arg(argv[arg]));
+			return;
 		}
 		//Check to see if there is enough arguments to the switch
 		if (argc-arg < j.value()->argn.size()+1) {
-			fprintf(stderr, "Not enough arguments parsed to %s\n\n", argv[arg]);
-			usage(stderr, false);
-			exit(1);
+			parseError(QString("Not enough arguments parsed to %1").arg(argv[arg]));
+			return;
 		}
 		if (!(*(j.value()))(argv+arg+1, *this, page)) {
-			fprintf(stderr, "Invalid argument(s) parsed to %s\n\n", argv[arg]);
-			usage(stderr, false);
-			exit(1);
+			parseError(QString("Invalid argument(s) parsed to %1").arg(argv[arg]));
+			return;
 		}
 #ifndef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
 		if (j.value()->qthack)
@@ -144,26 +153,22 @@ void CommandLineParserBase::parseArg(int sections, const int argc, const char **
 			QHash<char, ArgHandler*>::iterator k = shortToHandler.find(argv[c][j]);
 			//If the short argument is invalid print usage information and exit
 			if (k == shortToHandler.end()) {
-				fprintf(stderr, "Unknown switch -%c\n\n", argv[c][j]);
-				usage(stderr, false);
-				exit(1);
+				parseError(QString("Unknown switch -%1").arg(QChar(argv[c][j])));
+				return;
 			}
 
 			if (!(k.value()->section & sections)) {
-				fprintf(stderr, "-%c specified in incorrect location\n\n", argv[c][j]);
-				usage(stderr, false);
-				exit(1);
+				parseError(QString("-%1 specified in incorrect location").arg(QChar(argv[c][j])));
+				return;
 			}
 			//Check to see if there is enough arguments to the switch
 			if (argc-arg < k.value()->argn.size()+1) {
-				fprintf(stderr, "Not enough arguments parsed to -%c\n\n", argv[c][j]);
-				usage(stderr, false);
-				exit(1);
+				parseError(QString("Not enough arguments parsed to -%1").arg(QChar(argv[c][j])));
+				return;
 			}
 			if (!(*(k.value()))(argv+arg+1, *this, page)) {
-				fprintf(stderr, "Invalid argument(s) parsed to -%c\n\n", argv[c][j]);
-				usage(stderr, false);
-				exit(1);
+				parseError(QString("Invalid argument(s) parsed to -%1").arg(QChar(argv[c][j])));
+				return;
 			}
 #ifndef __EXTENSIVE_WKHTMLTOPDF_QT_HACK__
  			if (k.value()->qthack)
@@ -42,6 +42,11 @@ public:
 
 class CommandLineParserBase {
 public:
+	//Should the process exit on invalid arguments, otherwise error is set
+	bool exitOnError;
+	bool error;
+	QString errorString;
+
 	int currentMode;
 	QString currentSection;
 	bool currentExtended;
@@ -53,6 +58,8 @@ public:
 	QHash<QString, QList<ArgHandler *> > sectionArgumentHandles;
 	QHash<QString, QString> sectionDesc;
 
+	CommandLineParserBase(): exitOnError(true), error(false) {}
+
 	//basearguments.cc
 	void section(QString s, QString desc="");
 	void mode(int m);
@@ -71,6 +78,7 @@ public:
 	void outputAuthors(Outputter * o) const;
 	void outputStaticProblems(Outputter * o) const;
 	void outputProxyDoc(Outputter * o) const;
+	void outputRequestRulesDoc(Outputter * o) const;
 
 	//commandlineparserbase.cc
 	void outputSwitches(Outputter * o, bool extended, bool doc) const;
@@ -78,6 +86,7 @@ public:
 	virtual void license(FILE * fd) const;
 	virtual void version(FILE * fd) const;
 	void parseArg(int sections, const int argc, const char ** argv, bool & defaultMode, int & arg, char * page);
+	void parseError(const QString & message);
 
 	virtual QString appName() const = 0;
 	const char *appVersion() const;
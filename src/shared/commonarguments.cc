@@ -174,6 +174,10 @@ void CommandLineParserBase::addGlobalLoadArgs(LoadGlobal & s) {
 	qthack(false);
 
     addarg("cookie-jar", 0, "Read and write cookies from and to the supplied cookie jar file", new QStrSetter(s.cookieJar, "path") );
+	addarg("max-parallel-pages", 0, "Load and print at most this many objects at the same time, 0 for no limit", new IntSetter(s.maxParallelPages, "number"));
+	addarg("share-connections", 0, "Load all objects through one network access manager, so connections to the same host are reused", new ConstSetter<bool>(s.shareConnections, true));
+	addarg("memory-cache-size", 0, "Keep up to this many megabytes of cacheable responses in memory, shared by the header, footer, toc and page loads, 0 to disable (WebKit only, WebEngine always keeps an HTTP cache in memory)", new IntSetter(s.memoryCacheSize, "megabytes"));
+	addarg("share-memory-cache", 0, "Share the memory cache with the other conversions of a server or batch run (WebKit only, WebEngine keeps its HTTP cache for the next conversion loaded with the same settings)", new ConstSetter<bool>(s.shareMemoryCache, true));
 }
 
 void CommandLineParserBase::addWebArgs(Web & s) {
@@ -218,6 +222,8 @@ void CommandLineParserBase::addPageLoadArgs(LoadPage & s) {
 
 	addarg("javascript-delay",0,"Wait some milliseconds for javascript finish", new IntSetter(s.jsdelay,"msec"));
 	addarg("window-status",0,"Wait until window.status is equal to this string before rendering page", new QStrSetter(s.windowStatus, "windowStatus"));
+	addarg("network-idle",0,"Instead of the javascript delay, wait until there was no network activity for this many milliseconds, then for fonts, animation frames and queued tasks to settle (WebKit only waits for the network)", new IntSetter(s.networkIdle,"msec"));
+	addarg("network-idle-timeout",0,"Stop waiting for the network to become idle after this many milliseconds, 0 for no limit", new IntSetter(s.networkIdleTimeout,"msec"));
 
 	addarg("zoom",0,"Use this zoom factor", new FloatSetter(s.zoomFactor,"float",1.0));
 	addarg("cookie",0,"Set an additional cookie (repeatable), value should be url encoded.", new MapSetter<>(s.cookies, "name", "value"));
@@ -227,6 +233,7 @@ void CommandLineParserBase::addPageLoadArgs(LoadPage & s) {
 	addarg("disable-local-file-access", 0, "Do not allowed conversion of a local file to read in other local files, unless explicitly allowed with --allow", new ConstSetter<bool>(s.blockLocalFileAccess, true));
 	addarg("enable-local-file-access", 0, "Allowed conversion of a local file to read in other local files.", new ConstSetter<bool>(s.blockLocalFileAccess, false));
 	addarg("allow", 0, "Allow the file or files from the specified folder to be loaded (repeatable)", new StringListSetter(s.allowed,"path"));
+	addarg("request-rules", 0, "Block, rewrite to local files or stub out the requests matching the rules in the given file", new QStrSetter(s.requestRules, "path"));
 
 	addarg("cache-dir", 0, "Web cache directory", new QStrSetter(s.cacheDir,"path"));
 
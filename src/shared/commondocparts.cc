@@ -100,3 +100,21 @@ void CommandLineParserBase::outputProxyDoc(Outputter * o) const {
 				"None\n");
 	o->endSection();
 }
+
+void CommandLineParserBase::outputRequestRulesDoc(Outputter * o) const {
+	o->beginSection("Request Rules");
+	o->paragraph(
+		"The file given to --request-rules holds one rule per line, requests"
+		" matching a block rule are not made, requests matching a rewrite rule"
+		" load the given local file instead and requests matching a stub rule"
+		" get an empty response of the given mime type. The first matching rule"
+		" applies, empty lines and lines starting with # are skipped.");
+	o->verbatim(
+		"<rule> := \"block\" <pattern> | \"rewrite\" <pattern> <path> | \"stub\" <pattern> <mime type>?\n"
+		"<pattern> := \"regex:\" <regular expression> | <url with * and ?> | <url prefix>\n");
+	o->paragraph("Here are some examples:");
+	o->verbatim("block https://www.google-analytics.com/\n"
+				"stub *://*.doubleclick.net/* image/gif\n"
+				"rewrite https://fonts.example.com/inter.woff2 /usr/share/fonts/inter.woff2\n");
+	o->endSection();
+}
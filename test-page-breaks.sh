@@ -124,6 +124,50 @@ echo "6. Résumé final"
 echo "   → La section noire devrait commencer sur une nouvelle page avec WebEngine"
 echo ""
 
+# Aller-retour de la fusion des objets (WebEngine)
+echo "=========================================="
+echo -e "${YELLOW}🔗 Test de la fusion des objets${NC}"
+echo "=========================================="
+echo ""
+
+# Deux objets, deux copies et un décalage négatif des numéros de page :
+# le document fusionné doit être relu sans erreur et compter 4 fois les pages
+MERGED="$RESULTS_DIR/page-breaks-merged.pdf"
+MERGE_OK=1
+if wkhtmltopdf --render-backend webengine \
+               --quiet \
+               --copies 2 \
+               --page-offset -1 \
+               test-page-breaks.html \
+               test-page-breaks.html \
+               "$MERGED"; then
+    MERGED_PAGES=$(pdfinfo "$MERGED" 2>/dev/null | grep "Pages:" | awk '{print $2}' || echo "?")
+    echo -e "   📊 Nombre de pages: ${MERGED_PAGES}"
+    if [ "$WEBENGINE_PAGES" != "erreur" ] && [ "$WEBENGINE_PAGES" != "?" ] && [ "$MERGED_PAGES" != "?" ]; then
+        if [ "$MERGED_PAGES" -eq $((WEBENGINE_PAGES * 4)) ]; then
+            echo -e "${GREEN}   ✓ Nombre de pages attendu ($((WEBENGINE_PAGES * 4)))${NC}"
+        else
+            echo -e "${RED}   ✗ $((WEBENGINE_PAGES * 4)) pages attendues${NC}"
+            MERGE_OK=0
+        fi
+    fi
+    if command -v qpdf &> /dev/null; then
+        if qpdf --check "$MERGED" > /dev/null 2>&1; then
+            echo -e "${GREEN}   ✓ qpdf --check ne signale aucune erreur${NC}"
+        else
+            echo -e "${RED}   ✗ qpdf --check signale des erreurs:${NC}"
+            qpdf --check "$MERGED" 2>&1 | grep -iv "^checking\|^pdf version\|^file is not" | head -10 || true
+            MERGE_OK=0
+        fi
+    else
+        echo -e "${YELLOW}   ℹ qpdf n'est pas installé, la structure n'est pas vérifiée${NC}"
+    fi
+else
+    echo -e "${RED}   ✗ Erreur lors de la génération du PDF fusionné${NC}"
+    MERGE_OK=0
+fi
+echo ""
+
 # Ouvrir les PDFs automatiquement si possible
 echo "=========================================="
 echo -e "${BLUE}💡 Ouverture des PDFs...${NC}"
@@ -163,3 +207,8 @@ echo ""
 echo -e "${YELLOW}💡 Conseil:${NC} Utilisez un outil de comparaison PDF comme diffpdf ou compare-pdf"
 echo "            pour voir les différences pixel par pixel."
 echo ""
+
+# La fusion est vérifiée automatiquement, son échec fait échouer le script
+if [ "$MERGE_OK" -ne 1 ]; then
+    exit 1
+fi
@@ -0,0 +1,27 @@
+# Copyright 2010-2020 wkhtmltopdf authors
+#
+# This file is part of wkhtmltopdf.
+#
+# wkhtmltopdf is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# wkhtmltopdf is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with wkhtmltopdf.  If not, see <http:#www.gnu.org/licenses/>.
+
+# Unit tests of the PDF merger, run with make check
+TEMPLATE = app
+TARGET = tst_pdfmerger
+QT = core testlib
+CONFIG += testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src/lib
+HEADERS += ../../src/lib/pdfmerger.hh
+SOURCES += tst_pdfmerger.cc ../../src/lib/pdfmerger.cc
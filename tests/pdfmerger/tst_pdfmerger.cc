@@ -0,0 +1,370 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+//
+// Copyright 2010-2020 wkhtmltopdf authors
+//
+// This file is part of wkhtmltopdf.
+//
+// wkhtmltopdf is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// wkhtmltopdf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with wkhtmltopdf.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "pdfmerger.hh"
+#include <QBuffer>
+#include <QFile>
+#include <QRegularExpression>
+#include <QtTest>
+
+using namespace wkhtmltopdf;
+
+/*!
+  \brief A merged document, read back through its cross reference table
+*/
+struct Merged {
+	QHash<int, QByteArray> objects;
+	QByteArray trailer;
+	QByteArray catalog;
+	QList<int> kids;
+};
+
+static QByteArray fixture(const char * name) {
+	QFile file(QFINDTESTDATA(QString("fixtures/") + name));
+	if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+	return file.readAll();
+}
+
+/*!
+  \brief Get the object number of the reference stored under key, -1 if there is none
+*/
+static int ref(const QByteArray & dict, const char * key) {
+	QRegularExpressionMatch m = QRegularExpression(QString("/%1 (\\d+) 0 R").arg(key)).match(QString::fromLatin1(dict));
+	return m.hasMatch() ? m.captured(1).toInt() : -1;
+}
+
+/*!
+  \brief Get the object numbers of every reference in text
+*/
+static QList<int> refs(const QByteArray & text) {
+	QList<int> res;
+	QRegularExpressionMatchIterator i = QRegularExpression("(\\d+) 0 R").globalMatch(QString::fromLatin1(text));
+	while (i.hasNext()) res << i.next().captured(1).toInt();
+	return res;
+}
+
+/*!
+  \brief Split the output of the merger into its objects
+
+  Every object must be found at the offset the cross reference table
+  gives for it.
+*/
+static bool read(const QByteArray & pdf, Merged & m) {
+	int s = pdf.lastIndexOf("startxref\n");
+	if (s < 0 || !pdf.endsWith("%%EOF\n")) return false;
+	int xref = pdf.mid(s + 10, pdf.indexOf('\n', s + 10) - s - 10).toInt();
+	if (pdf.mid(xref, 5) != "xref\n") return false;
+	QList<QByteArray> lines = pdf.mid(xref, s - xref).split('\n');
+	int size = lines[1].split(' ').last().toInt();
+	if (lines[2] != "0000000000 65535 f ") return false;
+	for (int n = 1; n < size; ++n) {
+		const QByteArray & entry = lines[2 + n];
+		if (entry.size() != 19) return false;
+		if (entry.endsWith(" f ")) continue;
+		int offset = entry.left(10).toInt();
+		QByteArray head = QByteArray::number(n) + " 0 obj\n";
+		if (pdf.mid(offset, head.size()) != head) return false;
+		int end = pdf.indexOf("\nendobj\n", offset);
+		if (end < 0) return false;
+		m.objects[n] = pdf.mid(offset + head.size(), end - offset - head.size());
+	}
+	if (lines[2 + size] != "trailer") return false;
+	m.trailer = lines[3 + size];
+	m.catalog = m.objects.value(ref(m.trailer, "Root"));
+	QByteArray pages = m.objects.value(ref(m.catalog, "Pages"));
+	m.kids = refs(pages.mid(pages.indexOf("/Kids"), pages.indexOf("]") - pages.indexOf("/Kids")));
+	return true;
+}
+
+/*!
+  \brief Get the objects whose dictionary contains text
+*/
+static QList<int> find(const Merged & m, const QByteArray & text) {
+	QList<int> res;
+	for (QHash<int, QByteArray>::const_iterator i = m.objects.begin(); i != m.objects.end(); ++i)
+		if (i.value().contains(text)) res << i.key();
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+class TestPdfMerger: public QObject {
+	Q_OBJECT
+private slots:
+	void parsesXrefAndTrailer();
+	void parsesXrefStreams();
+	void rejectsObjectStreams();
+	void sharesIdenticalObjects();
+	void resolvesNamedDestinations();
+	void linksAcrossDocuments();
+	void findsDestinations();
+	void writesOutline();
+	void labelsPagesWithCopies_data();
+	void labelsPagesWithCopies();
+	void clonesAnnotationsOfCopies();
+};
+
+void TestPdfMerger::parsesXrefAndTrailer() {
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	QVERIFY(merger.append(fixture("simple.pdf")));
+	QCOMPARE(merger.pageCount(), 2);
+	QVERIFY(merger.finish());
+
+	Merged m;
+	QVERIFY(read(out, m));
+	QVERIFY(out.startsWith("%PDF-1.4\n"));
+	QCOMPARE(ref(m.trailer, "Root"), 1);
+	QVERIFY(m.objects.value(ref(m.trailer, "Info")).contains("/Title (Fixture)"));
+	QVERIFY(m.catalog.startsWith("<< /Type /Catalog /Pages 2 0 R"));
+	QVERIFY(m.objects.value(2).contains("/Count 2"));
+	QCOMPARE(m.kids.size(), 2);
+
+	//The attributes of the page tree are copied into the pages
+	foreach (int kid, m.kids) {
+		const QByteArray & page = m.objects.value(kid);
+		QVERIFY(page.contains("/Type /Page "));
+		QVERIFY(page.contains("/Parent 2 0 R"));
+		QVERIFY(page.contains("/MediaBox [0 0 612 792]"));
+		QVERIFY(m.objects.value(ref(page, "F1")).contains("/BaseFont /Helvetica"));
+	}
+	QVERIFY(m.objects.value(ref(m.objects.value(m.kids[0]), "Contents")).contains("(One) Tj"));
+	QVERIFY(m.objects.value(ref(m.objects.value(m.kids[1]), "Contents")).contains("(Two) Tj"));
+}
+
+void TestPdfMerger::parsesXrefStreams() {
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	QVERIFY(merger.append(fixture("xrefstream.pdf")));
+	QCOMPARE(merger.pageCount(), 1);
+	QVERIFY(merger.finish());
+
+	Merged m;
+	QVERIFY(read(out, m));
+	QVERIFY(find(m, "/Type /XRef").isEmpty());
+	QCOMPARE(m.kids.size(), 1);
+	QVERIFY(m.objects.value(m.kids[0]).contains("/MediaBox [0 0 595 842]"));
+}
+
+void TestPdfMerger::rejectsObjectStreams() {
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	QVERIFY(!merger.append(fixture("objstm.pdf")));
+	QCOMPARE(merger.errorString(), QString("Unable to parse the printed document"));
+	QVERIFY(!merger.append("<html></html>"));
+	QCOMPARE(merger.pageCount(), 0);
+	QVERIFY(!merger.finish());
+}
+
+void TestPdfMerger::sharesIdenticalObjects() {
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	QVERIFY(merger.append(fixture("simple.pdf")));
+	QVERIFY(merger.append(fixture("simple.pdf")));
+	QCOMPARE(merger.pageCount(), 4);
+	QVERIFY(merger.finish());
+
+	Merged m;
+	QVERIFY(read(out, m));
+	QCOMPARE(m.kids.size(), 4);
+	QCOMPARE(find(m, "/BaseFont /Helvetica").size(), 1);
+	QCOMPARE(find(m, "(One) Tj").size(), 1);
+	QCOMPARE(find(m, "(Two) Tj").size(), 1);
+	QCOMPARE(find(m, "/Title (Fixture)").size(), 1);
+	//The pages themselves are never shared
+	QCOMPARE(QSet<int>(m.kids.begin(), m.kids.end()).size(), 4);
+	QCOMPARE(ref(m.objects.value(m.kids[0]), "Contents"), ref(m.objects.value(m.kids[2]), "Contents"));
+}
+
+void TestPdfMerger::resolvesNamedDestinations() {
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	QVERIFY(merger.append(fixture("named.pdf")));
+	QVERIFY(merger.append(fixture("named.pdf")));
+	QVERIFY(merger.finish());
+
+	Merged m;
+	QVERIFY(read(out, m));
+	QCOMPARE(m.kids.size(), 4);
+	//The names of both documents are the same, each link keeps pointing into its own
+	QList<int> links = find(m, "/Subtype /Link");
+	QCOMPARE(links.size(), 2);
+	QCOMPARE(ref(m.objects.value(links[0]), "P"), m.kids[0]);
+	QVERIFY(m.objects.value(links[0]).contains("/Dest [" + QByteArray::number(m.kids[1]) + " 0 R /XYZ 0 500 null]"));
+	QCOMPARE(ref(m.objects.value(links[1]), "P"), m.kids[2]);
+	QVERIFY(m.objects.value(links[1]).contains("/Dest [" + QByteArray::number(m.kids[3]) + " 0 R /XYZ 0 500 null]"));
+	QVERIFY(find(m, "/target").isEmpty());
+	QVERIFY(!m.catalog.contains("/Dests"));
+}
+
+void TestPdfMerger::linksAcrossDocuments() {
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	QVERIFY(merger.append(fixture("linking.pdf")));
+	QVERIFY(merger.append(fixture("named.pdf")));
+	QVERIFY(merger.finish());
+
+	Merged m;
+	QVERIFY(read(out, m));
+	QCOMPARE(m.kids.size(), 3);
+	//The first document links to a name only the second one holds
+	QList<int> links = find(m, "/Subtype /Link");
+	QCOMPARE(links.size(), 2);
+	QVERIFY(m.objects.value(links[0]).contains("/Dest /target"));
+	QVERIFY(m.objects.value(links[1]).contains("/Dest [" + QByteArray::number(m.kids[2]) + " 0 R /XYZ 0 500 null]"));
+	QCOMPARE(m.objects.value(ref(m.catalog, "Dests")),
+			 "<< /target [" + QByteArray::number(m.kids[2]) + " 0 R /XYZ 0 500 null] >>");
+}
+
+void TestPdfMerger::findsDestinations() {
+	int pages = 0;
+	QHash<QByteArray, PdfMerger::Destination> dests;
+	QVERIFY(PdfMerger::destinations(fixture("named.pdf"), pages, dests));
+	QCOMPARE(pages, 2);
+	QCOMPARE(dests.size(), 1);
+	QCOMPARE(dests.value("target").page, 1);
+	QCOMPARE(dests.value("target").top, qreal(292));
+
+	dests.clear();
+	QVERIFY(PdfMerger::destinations(fixture("simple.pdf"), pages, dests));
+	QCOMPARE(pages, 2);
+	QVERIFY(dests.isEmpty());
+	QVERIFY(!PdfMerger::destinations(fixture("objstm.pdf"), pages, dests));
+}
+
+void TestPdfMerger::writesOutline() {
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	QVERIFY(merger.append(fixture("simple.pdf")));
+	merger.addOutlineEntry("Chapter", 0, 0);
+	merger.addOutlineEntry("Section", 1, 1, 100);
+	//Entries pointing past the last page are left out
+	merger.addOutlineEntry("Missing", 0, 2);
+	QVERIFY(merger.finish());
+
+	Merged m;
+	QVERIFY(read(out, m));
+	QVERIFY(m.catalog.contains("/PageMode /UseOutlines"));
+	QByteArray root = m.objects.value(ref(m.catalog, "Outlines"));
+	QVERIFY(root.startsWith("<< /Type /Outlines"));
+	QVERIFY(root.contains("/Count 2"));
+	QCOMPARE(ref(root, "First"), ref(root, "Last"));
+
+	QByteArray chapter = m.objects.value(ref(root, "First"));
+	QVERIFY(chapter.contains("/Title <FEFF0043006800610070007400650072>"));
+	QCOMPARE(ref(chapter, "Parent"), ref(m.catalog, "Outlines"));
+	QVERIFY(chapter.contains("/Count 1"));
+	QVERIFY(chapter.contains("/Dest [" + QByteArray::number(m.kids[0]) + " 0 R /XYZ null null null]"));
+
+	QByteArray section = m.objects.value(ref(chapter, "First"));
+	QVERIFY(section.contains("/Title <FEFF00530065006300740069006F006E>"));
+	QCOMPARE(ref(section, "Parent"), ref(root, "First"));
+	QVERIFY(section.contains("/Dest [" + QByteArray::number(m.kids[1]) + " 0 R /XYZ null 692.00 null]"));
+	QVERIFY(find(m, "<FEFF004D0069007300730069006E0067>").isEmpty());
+}
+
+void TestPdfMerger::labelsPagesWithCopies_data() {
+	QTest::addColumn<int>("offset");
+	QTest::addColumn<bool>("collate");
+	QTest::addColumn<QByteArray>("labels");
+	QTest::addColumn<QByteArray>("contents");
+
+	QTest::newRow("none") << 0 << true << QByteArray() << QByteArray("1212");
+	QTest::newRow("positive") << 3 << true
+							  << QByteArray(" /PageLabels << /Nums [0 << /S /D /St 4 >>] >>")
+							  << QByteArray("1212");
+	QTest::newRow("negative") << -1 << false
+							  << QByteArray(" /PageLabels << /Nums [0 << /P (0) >> 1 << /S /D /St 1 >>] >>")
+							  << QByteArray("1122");
+	QTest::newRow("below every page") << -5 << true
+									  << QByteArray(" /PageLabels << /Nums [0 << /P (-4) >> 1 << /P (-3) >> "
+													"2 << /P (-2) >> 3 << /P (-1) >>] >>")
+									  << QByteArray("1212");
+}
+
+void TestPdfMerger::labelsPagesWithCopies() {
+	QFETCH(int, offset);
+	QFETCH(bool, collate);
+	QFETCH(QByteArray, labels);
+	QFETCH(QByteArray, contents);
+
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	merger.setPageOffset(offset);
+	merger.setCopies(2, collate);
+	QVERIFY(merger.append(fixture("simple.pdf")));
+	//The page count is that of a single copy
+	QCOMPARE(merger.pageCount(), 2);
+	QVERIFY(merger.finish());
+
+	Merged m;
+	QVERIFY(read(out, m));
+	QVERIFY(m.objects.value(2).contains("/Count 4"));
+	QCOMPARE(m.kids.size(), 4);
+	QCOMPARE(QSet<int>(m.kids.begin(), m.kids.end()).size(), 4);
+	QCOMPARE(m.catalog, QByteArray("<< /Type /Catalog /Pages 2 0 R") + labels + " >>");
+
+	int one = find(m, "(One) Tj").value(0);
+	QByteArray order;
+	foreach (int kid, m.kids)
+		order += ref(m.objects.value(kid), "Contents") == one ? '1' : '2';
+	QCOMPARE(order, contents);
+}
+
+void TestPdfMerger::clonesAnnotationsOfCopies() {
+	QByteArray out;
+	QBuffer buffer(&out);
+	buffer.open(QIODevice::WriteOnly);
+	PdfMerger merger(&buffer);
+	merger.setCopies(2, true);
+	QVERIFY(merger.append(fixture("named.pdf")));
+	QVERIFY(merger.finish());
+
+	Merged m;
+	QVERIFY(read(out, m));
+	QCOMPARE(m.kids.size(), 4);
+	QList<int> links = find(m, "/Subtype /Link");
+	QCOMPARE(links.size(), 2);
+	//Every annotation belongs to the page listing it
+	QCOMPARE(refs(m.objects.value(m.kids[0]).mid(m.objects.value(m.kids[0]).indexOf("/Annots"))).value(0), links[0]);
+	QCOMPARE(refs(m.objects.value(m.kids[2]).mid(m.objects.value(m.kids[2]).indexOf("/Annots"))).value(0), links[1]);
+	QCOMPARE(ref(m.objects.value(links[0]), "P"), m.kids[0]);
+	QCOMPARE(ref(m.objects.value(links[1]), "P"), m.kids[2]);
+	QVERIFY(!m.objects.value(m.kids[1]).contains("/Annots"));
+	QVERIFY(!m.objects.value(m.kids[3]).contains("/Annots"));
+}
+
+QTEST_APPLESS_MAIN(TestPdfMerger)
+#include "tst_pdfmerger.moc"
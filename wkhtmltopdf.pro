@@ -19,3 +19,4 @@ TEMPLATE = subdirs
 
 CONFIG += ordered
 SUBDIRS = src/lib src/pdf src/image
+qtHaveModule(testlib): SUBDIRS += tests